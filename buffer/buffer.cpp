@@ -1,136 +1,5 @@
 #include "buffer.h"
 
-Buffer::Buffer(int initBufferSize): buffer_(initBufferSize),
-            readPos_(0), writePos_(0) {}
-
-size_t Buffer::ReadableBytes() const {
-    return writePos_ - readPos_;
-}
-
-size_t Buffer::WritableBytes() const {
-    return buffer_.size() - writePos_;
-}
-
-size_t Buffer::PrependableBytes() const {
-    return readPos_;
-}
-
-const char* Buffer::Peek() const {
-    return BeginPtr_() + readPos_;
-}
-
-void Buffer::Retrieve(size_t len) {
-    assert(len <= ReadableBytes());
-    readPos_ += len;
-}
-
-void Buffer::RetrieveUntil(const char* end) {
-    assert(Peek() <= end);
-    Retrieve(end - Peek());
-}
-
-void Buffer::RetrieveAll() {
-    bzero(&buffer_[0], buffer_.size());
-    readPos_ = 0;
-    writePos_ = 0;
-}
-
-std::string Buffer::RetrieveAllToStr() {
-    std::string str(Peek(), ReadableBytes());
-    RetrieveAll();
-    return str;
-}
-
-const char* Buffer::BeginWriteConst() const {
-    return BeginPtr_() + writePos_;
-}
-
-char* Buffer::BeginWrite() {
-    return BeginPtr_() + writePos_;
-}
-
-void Buffer::HasWritten(size_t len) {
-    writePos_ += len;
-}
-
-void Buffer::Append(const char* str, size_t len) {
-    assert(str);
-    EnsureWriteable(len);
-    std::copy(str, str+len, BeginWrite());
-    HasWritten(len);
-}
-
-void Buffer::Append(const std::string& str) {
-    Append(str.data(), str.length());
-}
-
-void Buffer::Append(const void* data, size_t len) {
-    assert(data);
-    Append(static_cast<const char*>(data), len);
-}
-
-void Buffer::Append(const Buffer& buff) {
-    Append(buff.Peek(), buff.ReadableBytes());
-}
-
-void Buffer::EnsureWriteable(size_t len) {
-    if(WritableBytes() < len) {
-        MakeSpace_(len);
-    }
-    assert(WritableBytes() >= len);
-}
-
-ssize_t Buffer::ReadFd(int fd, int* SaveErrno) {
-    char buff[65535];
-    struct iovec iov[2];                        // 指定多个缓冲区，一个指向buff_缓冲区，一个指向临时缓冲区
-    const size_t writable = WritableBytes();
-    iov[0].iov_base = BeginPtr_() + writePos_;
-    iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
-
-    const ssize_t len = readv(fd, iov, 2);      // 读取数据fd到两个缓冲区
-    if(len < 0) {
-        *SaveErrno = errno;
-    } else if(static_cast<size_t>(len) <= writable) {
-        writePos_ += len;
-    } else {
-        writePos_ = buffer_.size();
-        Append(buff, len - writable);
-    }
-
-    return len;
-}
-
-ssize_t Buffer::WriteFd(int fd, int* SaveErrno) {
-    size_t readSize = ReadableBytes();
-    ssize_t len = write(fd, Peek(), readSize);      // 将数据添加到缓冲区
-    if(len < 0) {
-        *SaveErrno = errno;
-        return len;
-    }
-    readPos_ += len;
-    return len;
-}
-
-char* Buffer::BeginPtr_() {
-    return &*buffer_.begin();
-}
-
-const char* Buffer::BeginPtr_() const {
-    return &*buffer_.begin();     // 首先buffer_.begin()获得第一个元素的迭代器，再解引用获得第一个元素，在取这个引用的地址
-}
-
-// 首先判断 len长度是否可写，将缓冲区的原始数据移动到最开端，再添加len长度的数据
-void Buffer::MakeSpace_(size_t len) {
-    if(WritableBytes() + PrependableBytes() < len) {
-        buffer_.resize(writePos_ + len + 1);
-    } 
-    else {
-        size_t readable = ReadableBytes();
-        std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, BeginPtr_());
-        readPos_ = 0;
-        writePos_ = readPos_ + readable;
-        assert(readable == ReadableBytes());
-    }
-}
\ No newline at end of file
+// 成员定义在buffer.h中，这里为两种游标策略各实例化一份，其他翻译单元不再重复生成
+template class BasicBuffer<PlainCursor>;
+template class BasicBuffer<AtomicCursor>;
@@ -4,60 +4,354 @@
 #include <iostream>
 #include <unistd.h>     // write
 #include <sys/uio.h>    // read
-#include <vector>
+#include <algorithm>
 #include <atomic>
+#include <string_view>
+#include <initializer_list>
+#include <type_traits>
 #include <assert.h>
 
+#include "scan.h"
+#include "bufferpool.h"
+
 /*
     提供一个高效可扩展的缓冲区，用于在网络编程或其他需要频繁读写的场景中存储
     和管理数据。
+    读写位置的类型由游标策略决定：连接和日志的缓冲区同一时刻只有一个线程访问
+    （跨线程交接由任务队列的锁保证可见性），使用普通整数，即Buffer；
+    一个线程写、另一个线程读的SPSC交接才需要原子游标，即AtomicBuffer。
+    存储空间在第一次写入时才从BufferPool申请，ReleaseStorage()后归还，
+    空闲的连接不占用缓冲区内存。
+    EnableMirror()后存储空间是镜像块，缓冲区按环形使用：读位置越过块尾后整体回退一圈，
+    可读和可写区域总是连续的，Peek()、BeginWrite()和ReadFd/WriteFd照常使用，
+    也不再需要把数据搬回开头；只用于Buffer，AtomicBuffer的两个游标不能由一方同时回退。
 */
 
-class Buffer {
+// 普通整数游标
+struct PlainCursor {
+    typedef size_t Type;
+    static size_t Load(const Type &pos) { return pos; }
+    static void Store(Type &pos, size_t val) { pos = val; }
+};
+
+// 原子游标：写方发布writePos_、读方发布readPos_，用acquire/release配对即可，不需要顺序一致；
+// 只有游标是原子的，扩容和整理空间仍要求另一方此时不在访问
+struct AtomicCursor {
+    typedef std::atomic<size_t> Type;
+    static size_t Load(const Type &pos) { return pos.load(std::memory_order_acquire); }
+    static void Store(Type &pos, size_t val) { pos.store(val, std::memory_order_release); }
+};
+
+template<class CursorPolicy>
+class BasicBuffer {
 
     // 返回缓冲区的起始位置
-    char* BeginPtr_();
-    const char* BeginPtr_() const;
+    char* BeginPtr_() { return buffer_; }
+    const char* BeginPtr_() const { return buffer_; }
+
+    size_t ReadPos_() const { return CursorPolicy::Load(readPos_); }
+    size_t WritePos_() const { return CursorPolicy::Load(writePos_); }
 
     // 确保缓冲区有充足空间
     void MakeSpace_(size_t len);
+    // 换一块能再放下len字节的存储空间，只拷贝未读的数据；镜像映射失败时退回普通存储
+    void Reallocate_(size_t len, bool mirror);
+    void FreeStorage_();
+    // 根据本次读到的字节数调整下次预留的空间
+    void AdjustReadHint_(size_t len, size_t writable);
 
-    std::vector<char> buffer_;
+    char* buffer_;              // 来自BufferPool，未申请时为nullptr
+    size_t capacity_;
+    size_t initSize_;           // 第一次申请的最小大小
+    bool mirrored_;             // buffer_是镜像块，[buffer_ + capacity_, buffer_ + 2 * capacity_)是它的第二份映射
     /*
         已读取的数据：从缓冲区的起始位置到 readPos_ 位置的数据，这些数据已经被读取过，可以被重新利用或预置新的数据。
         可读的数据：从 readPos_ 位置到 writePos_ 位置的数据，这些数据是当前缓冲区中尚未被读取的数据。
         可写的数据：从 writePos_ 位置到缓冲区末尾的数据，这些数据是当前缓冲区中尚未被写入的数据。
     */
-    std::atomic<std::size_t> readPos_;
-    std::atomic<std::size_t> writePos_;
+    typename CursorPolicy::Type readPos_;
+    typename CursorPolicy::Type writePos_;
+    size_t readHint_;           // ReadFd前至少留出的可写空间
 
 public:
-    Buffer(int initBufferSize = 1024);
-    ~Buffer() = default;
+    /*
+        ReadFd的读入大小自适应：一次读满了预留空间说明数据来得比预期快，预留加倍（最多MAX_READ_HINT），
+        读到的远少于预留时减半（最少MIN_READ_HINT），不用FIONREAD或MSG_PEEK多一次系统调用；
+        持续的大量数据（如大请求体）在预留增长后直接从内核读进缓冲区，
+        只有超出预留的突发部分才先读进线程共享的溢出区再拷贝一次
+    */
+    static constexpr size_t MIN_READ_HINT = 4096;
+    static constexpr size_t MAX_READ_HINT = 256 * 1024;
+    static constexpr size_t SPILL_SIZE = 64 * 1024;
+
+    BasicBuffer(int initBufferSize = 1024);
+    ~BasicBuffer();
+
+    BasicBuffer(const BasicBuffer&) = delete;
+    BasicBuffer& operator=(const BasicBuffer&) = delete;
 
     // 返回缓冲区中可写字节数、可读字节数和可预置字节数
-    size_t WritableBytes() const;
-    size_t ReadableBytes() const;
-    size_t PrependableBytes() const;
+    size_t WritableBytes() const { return (mirrored_ ? ReadPos_() + capacity_ : capacity_) - WritePos_(); }
+    size_t ReadableBytes() const { return WritePos_() - ReadPos_(); }
+    size_t PrependableBytes() const { return mirrored_ ? 0 : ReadPos_(); }
 
-    const char* Peek() const;          // 返回缓冲区中可读数据的起始地址
+    const char* Peek() const { return BeginPtr_() + ReadPos_(); }  // 返回缓冲区中可读数据的起始地址
+    const char* FindCRLF() const;      // 在可读数据中查找"\r\n"，返回'\r'的位置，没有时返回nullptr
+    const char* FindCRLF(const char* start) const;  // 从start开始查找
     void EnsureWriteable(size_t len);  // 确保缓冲区中有足够的可写空间
-    void HasWritten(size_t len);       // 添加数据到缓冲区
+    void HasWritten(size_t len) { CursorPolicy::Store(writePos_, WritePos_() + len); }  // 添加数据到缓冲区
+    void Unwrite(size_t len);          // 撤销最后写入的len字节
 
     void Retrieve(size_t len);            // 读走len长度的数据
     void RetrieveUntil(const char* end);  // 读走直到end的数据
     void RetrieveAll();                   // 清空缓冲区
     std::string RetrieveAllToStr();       // 读走所有数据并返回字符串
+    void ReleaseStorage();                // 丢弃所有数据，存储空间还给BufferPool；读入预留保留，空闲后再读时按原来的大小申请
+    size_t Capacity() const { return capacity_; }
+    // 改用镜像环形存储，已有数据拷贝一次；映射失败时保持普通存储并返回false，ReleaseStorage()后恢复普通存储
+    bool EnableMirror();
+    bool IsMirrored() const { return mirrored_; }
+    size_t ReadHint() const { return readHint_; }
+    void ResetReadHint() { readHint_ = MIN_READ_HINT; }    // 缓冲区交给新的连接时调用
 
-    const char* BeginWriteConst() const;  // 返回添加数据的起始位置
-    char* BeginWrite();                   // 返回添加数据的起始位置，区别主要在于起始位置能否修改
+    const char* BeginWriteConst() const { return BeginPtr_() + WritePos_(); }  // 返回添加数据的起始位置
+    char* BeginWrite() { return BeginPtr_() + WritePos_(); }   // 返回添加数据的起始位置，区别主要在于起始位置能否修改
 
     // 添加数据到缓冲区
-    void Append(const std::string& str);         
+    void Append(const std::string& str);
     void Append(const char* str, size_t len);
     void Append(const void* data, size_t len);
-    void Append(const Buffer& buff);
+    void Append(const BasicBuffer& buff);
+    void Append(std::initializer_list<std::string_view> parts);   // 多段数据只检查一次空间，依次拷贝
 
     ssize_t ReadFd(int fd, int* Errno);   // 用于从文件描述符读取数据到缓冲区
     ssize_t WriteFd(int fd, int* Errno);  // 用于从缓冲区写入数据到文件描述符
-};
\ No newline at end of file
+};
+
+typedef BasicBuffer<PlainCursor> Buffer;
+typedef BasicBuffer<AtomicCursor> AtomicBuffer;
+
+// 两种缓冲区在buffer.cpp中实例化，其他策略（如基准中的对照组）在使用处隐式实例化
+extern template class BasicBuffer<PlainCursor>;
+extern template class BasicBuffer<AtomicCursor>;
+
+template<class CursorPolicy>
+BasicBuffer<CursorPolicy>::BasicBuffer(int initBufferSize): buffer_(nullptr), capacity_(0),
+            initSize_(initBufferSize), mirrored_(false), readPos_(0), writePos_(0), readHint_(MIN_READ_HINT) {}
+
+template<class CursorPolicy>
+BasicBuffer<CursorPolicy>::~BasicBuffer() {
+    ReleaseStorage();
+}
+
+template<class CursorPolicy>
+const char* BasicBuffer<CursorPolicy>::FindCRLF() const {
+    return Scan::FindCRLF(Peek(), BeginWriteConst());
+}
+
+template<class CursorPolicy>
+const char* BasicBuffer<CursorPolicy>::FindCRLF(const char* start) const {
+    assert(Peek() <= start && start <= BeginWriteConst());
+    return Scan::FindCRLF(start, BeginWriteConst());
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Retrieve(size_t len) {
+    assert(len <= ReadableBytes());
+    size_t pos = ReadPos_() + len;
+    if(mirrored_ && pos >= capacity_) {
+        // 读位置进入第二份映射，两个游标一起回退一圈，指向的仍是同一份数据
+        pos -= capacity_;
+        CursorPolicy::Store(writePos_, WritePos_() - capacity_);
+    }
+    CursorPolicy::Store(readPos_, pos);
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::RetrieveUntil(const char* end) {
+    assert(Peek() <= end);
+    Retrieve(end - Peek());
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::RetrieveAll() {
+    if(buffer_)
+        bzero(buffer_, capacity_);
+    CursorPolicy::Store(readPos_, 0);
+    CursorPolicy::Store(writePos_, 0);
+}
+
+template<class CursorPolicy>
+std::string BasicBuffer<CursorPolicy>::RetrieveAllToStr() {
+    std::string str(Peek(), ReadableBytes());
+    RetrieveAll();
+    return str;
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::ReleaseStorage() {
+    if(buffer_) {
+        FreeStorage_();
+        buffer_ = nullptr;
+        capacity_ = 0;
+    }
+    mirrored_ = false;
+    CursorPolicy::Store(readPos_, 0);
+    CursorPolicy::Store(writePos_, 0);
+}
+
+template<class CursorPolicy>
+bool BasicBuffer<CursorPolicy>::EnableMirror() {
+    assert((std::is_same<CursorPolicy, PlainCursor>::value));
+    if(!mirrored_)
+        Reallocate_(std::max(WritableBytes(), readHint_), true);
+    return mirrored_;
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Unwrite(size_t len) {
+    assert(len <= ReadableBytes());
+    CursorPolicy::Store(writePos_, WritePos_() - len);
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Append(const char* str, size_t len) {
+    assert(str);
+    EnsureWriteable(len);
+    std::copy(str, str+len, BeginWrite());
+    HasWritten(len);
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Append(const std::string& str) {
+    Append(str.data(), str.length());
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Append(const void* data, size_t len) {
+    assert(data);
+    Append(static_cast<const char*>(data), len);
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Append(const BasicBuffer& buff) {
+    Append(buff.Peek(), buff.ReadableBytes());
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Append(std::initializer_list<std::string_view> parts) {
+    size_t len = 0;
+    for(std::string_view part : parts)
+        len += part.size();
+    EnsureWriteable(len);
+    char* dst = BeginWrite();
+    for(std::string_view part : parts) {
+        std::copy(part.begin(), part.end(), dst);
+        dst += part.size();
+    }
+    HasWritten(len);
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::EnsureWriteable(size_t len) {
+    if(WritableBytes() < len) {
+        MakeSpace_(len);
+    }
+    assert(WritableBytes() >= len);
+}
+
+template<class CursorPolicy>
+ssize_t BasicBuffer<CursorPolicy>::ReadFd(int fd, int* SaveErrno) {
+    // 溢出区每个线程一块，不再每次调用在栈上占64KB
+    static thread_local char spill[SPILL_SIZE];
+    if(WritableBytes() < readHint_)
+        EnsureWriteable(readHint_);
+    struct iovec iov[2];                        // 指定多个缓冲区，一个指向buff_缓冲区，一个指向溢出区
+    const size_t writable = WritableBytes();
+    iov[0].iov_base = BeginWrite();
+    iov[0].iov_len = writable;
+    iov[1].iov_base = spill;
+    iov[1].iov_len = sizeof(spill);
+
+    const ssize_t len = readv(fd, iov, 2);      // 读取数据fd到两个缓冲区
+    if(len < 0) {
+        *SaveErrno = errno;
+        return len;
+    }
+    if(static_cast<size_t>(len) <= writable) {
+        HasWritten(len);
+    } else {
+        HasWritten(writable);
+        Append(spill, len - writable);
+    }
+    AdjustReadHint_(len, writable);
+    return len;
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::AdjustReadHint_(size_t len, size_t writable) {
+    if(len >= writable) {
+        size_t hint = std::max(readHint_ * 2, len);
+        readHint_ = std::min(hint, MAX_READ_HINT);
+    }
+    else if(len < readHint_ / 4) {
+        readHint_ = std::max(readHint_ / 2, MIN_READ_HINT);
+    }
+}
+
+template<class CursorPolicy>
+ssize_t BasicBuffer<CursorPolicy>::WriteFd(int fd, int* SaveErrno) {
+    size_t readSize = ReadableBytes();
+    ssize_t len = write(fd, Peek(), readSize);      // 将数据添加到缓冲区
+    if(len < 0) {
+        *SaveErrno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
+
+// 首先判断 len长度是否可写，将缓冲区的原始数据移动到最开端，再添加len长度的数据；
+// 空间不够时换一块更大的。镜像存储的可预置字节数总是0，只会换块，不会搬动数据
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::MakeSpace_(size_t len) {
+    if(WritableBytes() + PrependableBytes() < len) {
+        Reallocate_(len, mirrored_);
+    }
+    else {
+        size_t readable = ReadableBytes();
+        std::copy(BeginPtr_() + ReadPos_(), BeginPtr_() + WritePos_(), BeginPtr_());
+        CursorPolicy::Store(readPos_, 0);
+        CursorPolicy::Store(writePos_, readable);
+        assert(readable == ReadableBytes());
+    }
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::Reallocate_(size_t len, bool mirror) {
+    size_t readable = ReadableBytes();
+    size_t need = std::max(readable + len, initSize_);
+    size_t cap = 0;
+    char* block = mirror ? BufferPool::AllocMirror(need, &cap) : nullptr;
+    if(!block) {
+        mirror = false;
+        block = BufferPool::Alloc(need, &cap);
+    }
+    if(buffer_) {
+        memcpy(block, Peek(), readable);
+        FreeStorage_();
+    }
+    buffer_ = block;
+    capacity_ = cap;
+    mirrored_ = mirror;
+    CursorPolicy::Store(readPos_, 0);
+    CursorPolicy::Store(writePos_, readable);
+}
+
+template<class CursorPolicy>
+void BasicBuffer<CursorPolicy>::FreeStorage_() {
+    if(mirrored_)
+        BufferPool::FreeMirror(buffer_, capacity_);
+    else
+        BufferPool::Free(buffer_, capacity_);
+}
@@ -0,0 +1,92 @@
+/*
+    Buffer游标策略的微基准：比较原来的顺序一致原子游标、acquire/release原子游标和普通整数游标。
+    模拟连接上的用法：连续Append若干条消息，再逐条Peek、Retrieve，统计每字节和每次操作的耗时。
+    另比较流式读入时普通存储（整理时搬动未读数据）和镜像环形存储：每次读入一块，只取走其中完整的记录。
+    g++ -std=c++17 -O2 buffer_bench.cpp buffer.cpp bufferpool.cpp scan.cpp -o buffer_bench
+*/
+#include <stdio.h>
+#include <string>
+#include <chrono>
+
+#include "buffer.h"
+
+// 改动前的Buffer：std::atomic的默认操作，每次存储都是一次完整的内存屏障
+struct SeqCstCursor {
+    typedef std::atomic<size_t> Type;
+    static size_t Load(const Type &pos) { return pos; }
+    static void Store(Type &pos, size_t val) { pos = val; }
+};
+
+static const int BATCH = 64;
+static const size_t TOTAL_BYTES = 512 * 1024 * 1024;
+
+template<class CursorPolicy>
+static double Run(size_t msgLen, unsigned long &sum) {
+    BasicBuffer<CursorPolicy> buff(BATCH * msgLen + 1);
+    std::string msg(msgLen, 'x');
+    const size_t rounds = TOTAL_BYTES / (BATCH * msgLen);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; r++) {
+        for(int i = 0; i < BATCH; i++)
+            buff.Append(msg.data(), msgLen);
+        while(buff.ReadableBytes() >= msgLen) {
+            sum += static_cast<unsigned char>(buff.Peek()[msgLen - 1]);
+            buff.Retrieve(msgLen);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (rounds * BATCH);
+}
+
+template<class CursorPolicy>
+static void Report(const char* name, size_t msgLen) {
+    unsigned long sum = 0;
+    double ns = Run<CursorPolicy>(msgLen, sum);
+    printf("%-8zu %-8s %10.2f %10.3f%s\n", msgLen, name, ns, ns / msgLen,
+           sum == 0 ? " !" : "");
+}
+
+// 每次写入chunk字节，取走其中完整的record，剩下的不完整记录留到下一次，普通存储整理时要搬动它
+static double RunStream(bool mirror, size_t chunk, size_t record, unsigned long &sum) {
+    Buffer buff;
+    if(mirror && !buff.EnableMirror())
+        return 0;
+    std::string data(chunk, 'y');
+    const size_t rounds = TOTAL_BYTES / chunk;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < rounds; r++) {
+        buff.EnsureWriteable(64 * 1024);
+        memcpy(buff.BeginWrite(), data.data(), chunk);
+        buff.HasWritten(chunk);
+        size_t n = buff.ReadableBytes() / record * record;
+        sum += static_cast<unsigned char>(buff.Peek()[0]);
+        buff.Retrieve(n);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (rounds * chunk);
+}
+
+int main() {
+    printf("%-8s %-8s %10s %10s\n", "msg", "cursor", "ns/op", "ns/byte");
+    const size_t sizes[] = { 8, 64, 512, 4096 };
+    for(size_t msgLen : sizes) {
+        Report<SeqCstCursor>("seq_cst", msgLen);
+        Report<AtomicCursor>("acq_rel", msgLen);
+        Report<PlainCursor>("plain", msgLen);
+    }
+
+    printf("\n%-8s %-8s %-8s %10s\n", "chunk", "record", "storage", "ns/byte");
+    const size_t chunks[] = { 4096, 65536 };
+    const size_t records[] = { 1000, 16393, 100000 };
+    for(size_t chunk : chunks) {
+        for(size_t record : records) {
+            unsigned long sum = 0;
+            printf("%-8zu %-8zu %-8s %10.3f\n", chunk, record, "plain", RunStream(false, chunk, record, sum));
+            printf("%-8zu %-8zu %-8s %10.3f%s\n", chunk, record, "mirror", RunStream(true, chunk, record, sum),
+                   sum == 0 ? " !" : "");
+        }
+    }
+    return 0;
+}
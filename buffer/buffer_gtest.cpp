@@ -1,11 +1,47 @@
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <thread>
 #include "buffer.h"
+#include "chainbuffer.h"
 
 TEST(BufferTest, Initialization) {
+    // 存储空间在第一次写入时才申请
     Buffer buffer;
     EXPECT_EQ(buffer.ReadableBytes(), 0);
-    EXPECT_EQ(buffer.WritableBytes(), 1024);
+    EXPECT_EQ(buffer.WritableBytes(), 0);
     EXPECT_EQ(buffer.PrependableBytes(), 0);
+    buffer.EnsureWriteable(1);
+    EXPECT_EQ(buffer.WritableBytes(), 1024);
+}
+
+TEST(BufferTest, PooledStorage) {
+    size_t inUse = BufferPool::InUseBytes();
+    Buffer buffer;
+    buffer.Append(std::string(3000, 'x'));
+    const char* block = buffer.Peek();
+    EXPECT_EQ(buffer.Capacity(), 4096u);
+    EXPECT_EQ(BufferPool::InUseBytes(), inUse + 4096);
+
+    buffer.Retrieve(3000);
+    size_t pooled = BufferPool::PooledBytes();
+    buffer.ReleaseStorage();
+    EXPECT_EQ(buffer.Capacity(), 0u);
+    EXPECT_EQ(BufferPool::InUseBytes(), inUse);
+    EXPECT_EQ(BufferPool::PooledBytes(), pooled + 4096);
+
+    // 同一线程再申请同一级别时复用刚归还的块
+    Buffer other;
+    other.EnsureWriteable(4000);
+    EXPECT_EQ(other.Peek(), block);
+    EXPECT_EQ(BufferPool::PooledBytes(), pooled);
+
+    // 扩容换块时只保留未读数据
+    other.Append(std::string(4000, 'a'));
+    other.Retrieve(3990);
+    other.Append(std::string(300 * 1024, 'b'));
+    EXPECT_EQ(other.PrependableBytes(), 0u);
+    EXPECT_EQ(other.ReadableBytes(), 10 + 300 * 1024u);
+    EXPECT_EQ(other.Capacity(), 10 + 300 * 1024u);
 }
 
 TEST(BufferTest, AppendAndRetrieve) {
@@ -17,6 +53,264 @@ TEST(BufferTest, AppendAndRetrieve) {
     EXPECT_EQ(buffer.ReadableBytes(), 0);
 }
 
+TEST(BufferTest, AppendParts) {
+    Buffer buffer(8);
+    std::string big(2000, 'x');
+    buffer.Append({ "HTTP/1.1 200 OK\r\n", big, std::string_view(), "\r\n" });
+    EXPECT_EQ(buffer.RetrieveAllToStr(), "HTTP/1.1 200 OK\r\n" + big + "\r\n");
+}
+
+TEST(BufferTest, AtomicCursor) {
+    // 两种游标策略只是读写位置的类型不同，行为一致
+    AtomicBuffer buffer(8);
+    buffer.Append("GET / HTTP/1.1\r\n", 16);
+    EXPECT_EQ(buffer.FindCRLF() - buffer.Peek(), 14);
+    buffer.Retrieve(4);
+    buffer.Append(std::string(100, 'y'));
+    EXPECT_EQ(buffer.ReadableBytes(), 112u);
+    buffer.Unwrite(100);
+    EXPECT_EQ(buffer.RetrieveAllToStr(), "/ HTTP/1.1\r\n");
+}
+
+TEST(BufferTest, ReadFdLargeTransfer) {
+    // 大量连续数据：预留空间逐步增长，内容不能错位或丢失
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::string data(4 * 1024 * 1024, '\0');
+    for(size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<char>(i * 131 + (i >> 12));
+    std::thread writer([&] {
+        size_t sent = 0;
+        while(sent < data.size()) {
+            ssize_t n = write(fds[1], data.data() + sent, data.size() - sent);
+            ASSERT_GT(n, 0);
+            sent += n;
+        }
+        close(fds[1]);
+    });
+
+    Buffer buffer;
+    int err = 0;
+    ssize_t len;
+    while((len = buffer.ReadFd(fds[0], &err)) > 0)
+        ;
+    writer.join();
+    close(fds[0]);
+    EXPECT_EQ(len, 0);
+    ASSERT_EQ(buffer.ReadableBytes(), data.size());
+    EXPECT_TRUE(buffer.RetrieveAllToStr() == data);
+}
+
+TEST(BufferTest, ReadHintSurvivesRelease) {
+    // 空闲时归还存储空间不影响读入预留，连接下次读入仍按学到的大小申请
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::string data(64 * 1024, 'x');
+    ASSERT_EQ(write(fds[1], data.data(), data.size()), (ssize_t)data.size());
+    Buffer buffer;
+    int err = 0;
+    EXPECT_GT(buffer.ReadFd(fds[0], &err), 0);
+    size_t hint = buffer.ReadHint();
+    EXPECT_GT(hint, Buffer::MIN_READ_HINT);
+
+    buffer.ReleaseStorage();
+    EXPECT_EQ(buffer.Capacity(), 0u);
+    EXPECT_EQ(buffer.ReadHint(), hint);
+    buffer.ResetReadHint();
+    EXPECT_EQ(buffer.ReadHint(), Buffer::MIN_READ_HINT);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(BufferTest, MirrorRing) {
+    Buffer buffer;
+    buffer.Append("abc", 3);
+    ASSERT_TRUE(buffer.EnableMirror());
+    const size_t cap = buffer.Capacity();
+    const char* base = buffer.Peek();
+    EXPECT_EQ(buffer.RetrieveAllToStr(), "abc");
+
+    // 反复写入、取走，读写位置绕过块尾时数据仍连续，存储空间不变
+    std::string msg(cap / 3 + 7, '\0');
+    for(int round = 0; round < 20; round++) {
+        for(size_t i = 0; i < msg.size(); i++)
+            msg[i] = static_cast<char>(round * 31 + i);
+        buffer.Append(msg);
+        buffer.Append("\r\n", 2);
+        ASSERT_EQ(buffer.FindCRLF() - buffer.Peek(), static_cast<long>(msg.size()));
+        ASSERT_EQ(std::string(buffer.Peek(), msg.size()), msg);
+        buffer.Retrieve(msg.size() + 2);
+        ASSERT_LT(buffer.Peek(), base + cap);
+        ASSERT_EQ(buffer.PrependableBytes(), 0u);
+    }
+    EXPECT_EQ(buffer.Capacity(), cap);
+
+    // 放不下时换更大的镜像块，未读数据保留
+    buffer.Append("head", 4);
+    buffer.Append(std::string(cap, 'z'));
+    EXPECT_TRUE(buffer.IsMirrored());
+    EXPECT_EQ(buffer.Capacity(), 2 * cap);
+    EXPECT_EQ(buffer.RetrieveAllToStr(), "head" + std::string(cap, 'z'));
+
+    buffer.ReleaseStorage();
+    EXPECT_FALSE(buffer.IsMirrored());
+}
+
+TEST(BufferTest, MirrorPooled) {
+    // 归还的镜像块留在线程缓存中，同样大小的申请直接复用，映射保持不变
+    size_t cap = 0, again = 0;
+    char* block = BufferPool::AllocMirror(100 * 1024, &cap);
+    ASSERT_NE(block, nullptr);
+    block[100] = 'm';
+    EXPECT_EQ(block[cap + 100], 'm');
+    size_t pooled = BufferPool::PooledBytes();
+    BufferPool::FreeMirror(block, cap);
+    EXPECT_EQ(BufferPool::PooledBytes(), pooled + cap);
+
+    EXPECT_EQ(BufferPool::AllocMirror(cap, &again), block);
+    EXPECT_EQ(again, cap);
+    EXPECT_EQ(BufferPool::PooledBytes(), pooled);
+    block[cap + 200] = 'n';
+    EXPECT_EQ(block[200], 'n');
+    BufferPool::FreeMirror(block, cap);
+}
+
+TEST(BufferTest, MirrorReadWriteFd) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::string data(4 * 1024 * 1024, '\0');
+    for(size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<char>(i * 7 + (i >> 11));
+    std::thread writer([&] {
+        size_t sent = 0;
+        while(sent < data.size()) {
+            ssize_t n = write(fds[1], data.data() + sent, std::min<size_t>(data.size() - sent, 50000));
+            ASSERT_GT(n, 0);
+            sent += n;
+        }
+        close(fds[1]);
+    });
+
+    // 边读边取走一部分，读写位置不断绕圈
+    Buffer buffer;
+    ASSERT_TRUE(buffer.EnableMirror());
+    std::string out;
+    int err = 0;
+    while(buffer.ReadFd(fds[0], &err) > 0) {
+        size_t n = buffer.ReadableBytes() * 3 / 4;
+        out.append(buffer.Peek(), n);
+        buffer.Retrieve(n);
+    }
+    writer.join();
+    close(fds[0]);
+    out += buffer.RetrieveAllToStr();
+    EXPECT_TRUE(out == data);
+
+    // WriteFd直接从跨过块尾的可读区域发送
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    buffer.Append(std::string(buffer.Capacity() - 100, 'a'));
+    buffer.Retrieve(buffer.ReadableBytes());
+    buffer.Append(data.data(), 1000);
+    EXPECT_EQ(buffer.WriteFd(fds[1], &err), 1000);
+    char got[1000];
+    ASSERT_EQ(read(fds[0], got, sizeof(got)), 1000);
+    EXPECT_EQ(memcmp(got, data.data(), 1000), 0);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(ChainBufferTest, AppendAndRetrieve) {
+    const size_t slab = SlabPool::SLAB_SIZE;
+    std::string data(slab * 3 + 100, '\0');
+    for(size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<char>(i % 251);
+    ChainBuffer chain;
+    chain.Append(data.data(), 10);
+    chain.Append(data.data() + 10, data.size() - 10);
+    EXPECT_EQ(chain.ReadableBytes(), data.size());
+    EXPECT_EQ(chain.SlabCount(), 4u);
+
+    // 跨slab取走，读完的slab立即归还
+    size_t freeBefore = SlabPool::Instance()->FreeCount();
+    chain.Retrieve(slab * 2 + 5);
+    EXPECT_EQ(chain.SlabCount(), 2u);
+    EXPECT_EQ(SlabPool::Instance()->FreeCount(), freeBefore + 2);
+    struct iovec iov[8];
+    ASSERT_EQ(chain.GetIov(iov, 8), 2);
+    EXPECT_EQ(iov[0].iov_len, slab - 5);
+    EXPECT_EQ(chain.RetrieveAllToStr(), data.substr(slab * 2 + 5));
+    EXPECT_EQ(chain.SlabCount(), 0u);
+}
+
+TEST(ChainBufferTest, SpliceAndBackfill) {
+    ChainBuffer head, body;
+    char* size = head.AppendSpace(4);
+    head.Append("\r\n");
+    body.Append(std::string(SlabPool::SLAB_SIZE + 1, 'b'));
+    const char* bodyFirst = nullptr;
+    struct iovec iov[4];
+    ASSERT_EQ(body.GetIov(iov, 4), 2);
+    bodyFirst = static_cast<const char*>(iov[0].iov_base);
+
+    // 拼接不拷贝：body的slab原样接到head后面
+    head.Append(std::move(body));
+    EXPECT_EQ(body.ReadableBytes(), 0u);
+    EXPECT_EQ(head.ReadableBytes(), 6 + SlabPool::SLAB_SIZE + 1);
+    ASSERT_EQ(head.GetIov(iov, 4), 3);
+    EXPECT_EQ(iov[1].iov_base, bodyFirst);
+
+    // 之前占的位置仍然有效
+    memcpy(size, "4001", 4);
+    head.Append("xyz");
+    head.Unwrite(3);
+    std::string out = head.RetrieveAllToStr();
+    EXPECT_EQ(out, "4001\r\n" + std::string(SlabPool::SLAB_SIZE + 1, 'b'));
+}
+
+TEST(ChainBufferTest, ReadAndWriteFd) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::string data(1024 * 1024, '\0');
+    for(size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<char>(i * 7 + (i >> 10));
+    std::thread writer([&] {
+        ChainBuffer out;
+        out.Append(data);
+        int err = 0;
+        while(out.ReadableBytes() > 0)
+            ASSERT_GT(out.WriteFd(fds[1], &err), 0);
+        close(fds[1]);
+    });
+
+    ChainBuffer in;
+    int err = 0;
+    while(in.ReadFd(fds[0], &err) > 0)
+        ;
+    writer.join();
+    close(fds[0]);
+    ASSERT_EQ(in.ReadableBytes(), data.size());
+    EXPECT_TRUE(in.RetrieveAllToStr() == data);
+}
+
+TEST(BufferTest, FindCRLF) {
+    // 各种实现在不同偏移下都要找到同一个位置，且不能越过可读数据
+    const Scan::Impl impls[] = { Scan::IMPL_SCALAR, Scan::IMPL_SSE42, Scan::IMPL_AVX2 };
+    Scan::Impl saved = Scan::Current();
+    for(Scan::Impl impl : impls) {
+        if(!Scan::Use(impl))
+            continue;
+        for(size_t pos = 0; pos < 70; pos++) {
+            Buffer buffer;
+            buffer.Append(std::string(pos, 'a') + "\r\nbc\r");
+            const char* crlf = buffer.FindCRLF();
+            ASSERT_NE(crlf, nullptr);
+            EXPECT_EQ(crlf - buffer.Peek(), pos);
+            EXPECT_EQ(buffer.FindCRLF(crlf + 2), nullptr);
+        }
+    }
+    Scan::Use(saved);
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,175 @@
+#include "bufferpool.h"
+
+#include <atomic>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static_assert(BufferPool::MIN_BLOCK << (BufferPool::CLASS_NUM - 1) == BufferPool::MAX_BLOCK,
+              "CLASS_NUM does not match MIN_BLOCK..MAX_BLOCK");
+
+namespace {
+
+// 空闲块的头部用作链表指针
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// 空闲镜像块的头部，大小不止一级，各块自己记录
+struct MirrorBlock {
+    MirrorBlock* next;
+    size_t cap;
+};
+
+// 平凡析构：线程退出时其他thread_local对象（如日志缓冲区）析构中归还的块仍能访问这里
+struct ThreadCache {
+    FreeBlock* head[BufferPool::CLASS_NUM];
+    MirrorBlock* mirrors;
+    size_t cachedBytes;
+    bool dead;                  // 已由Reaper清空，之后归还的块直接释放
+};
+
+thread_local ThreadCache cache;
+
+struct CacheReaper {
+    ~CacheReaper();
+};
+
+thread_local CacheReaper reaper;
+
+std::atomic<size_t> pooledBytes(0);
+std::atomic<size_t> inUseBytes(0);
+
+CacheReaper::~CacheReaper() {
+    for(int i = 0; i < BufferPool::CLASS_NUM; i++) {
+        while(cache.head[i]) {
+            FreeBlock* block = cache.head[i];
+            cache.head[i] = block->next;
+            delete[] reinterpret_cast<char*>(block);
+        }
+    }
+    while(cache.mirrors) {
+        MirrorBlock* block = cache.mirrors;
+        cache.mirrors = block->next;
+        munmap(block, 2 * block->cap);
+    }
+    pooledBytes.fetch_sub(cache.cachedBytes, std::memory_order_relaxed);
+    cache.cachedBytes = 0;
+    cache.dead = true;
+}
+
+}
+
+int BufferPool::ClassOf_(size_t len) {
+    int cls = 0;
+    size_t size = MIN_BLOCK;
+    while(size < len) {
+        size <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+char* BufferPool::Alloc(size_t len, size_t* cap) {
+    assert(cap);
+    if(len > MAX_BLOCK) {
+        *cap = len;
+        inUseBytes.fetch_add(len, std::memory_order_relaxed);
+        return new char[len];
+    }
+    const int cls = ClassOf_(len);
+    const size_t size = MIN_BLOCK << cls;
+    *cap = size;
+    inUseBytes.fetch_add(size, std::memory_order_relaxed);
+    FreeBlock* block = cache.head[cls];
+    if(block) {
+        cache.head[cls] = block->next;
+        cache.cachedBytes -= size;
+        pooledBytes.fetch_sub(size, std::memory_order_relaxed);
+        return reinterpret_cast<char*>(block);
+    }
+    return new char[size];
+}
+
+void BufferPool::Free(char* block, size_t cap) {
+    assert(block);
+    inUseBytes.fetch_sub(cap, std::memory_order_relaxed);
+    // 块的大小恰好是某一级时才可能来自池中，大块直接释放
+    if(cap > MAX_BLOCK || cache.dead || cache.cachedBytes + cap > MAX_THREAD_CACHE) {
+        delete[] block;
+        return;
+    }
+    const int cls = ClassOf_(cap);
+    assert((MIN_BLOCK << cls) == cap);
+    (void)&reaper;              // 第一次缓存时构造，线程退出时清空缓存
+    FreeBlock* free = reinterpret_cast<FreeBlock*>(block);
+    free->next = cache.head[cls];
+    cache.head[cls] = free;
+    cache.cachedBytes += cap;
+    pooledBytes.fetch_add(cap, std::memory_order_relaxed);
+}
+
+char* BufferPool::AllocMirror(size_t len, size_t* cap) {
+    assert(cap);
+    size_t size = sysconf(_SC_PAGESIZE);
+    while(size < len)
+        size <<= 1;
+    for(MirrorBlock** link = &cache.mirrors; *link; link = &(*link)->next) {
+        MirrorBlock* block = *link;
+        if(block->cap == size) {
+            *link = block->next;
+            cache.cachedBytes -= size;
+            pooledBytes.fetch_sub(size, std::memory_order_relaxed);
+            inUseBytes.fetch_add(size, std::memory_order_relaxed);
+            *cap = size;
+            return reinterpret_cast<char*>(block);
+        }
+    }
+    int fd = memfd_create("buffer", MFD_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+    if(ftruncate(fd, size) < 0) {
+        close(fd);
+        return nullptr;
+    }
+    // 先占住连续2倍大小的地址，再把文件映射到前后两半
+    char* base = static_cast<char*>(mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if(base == MAP_FAILED) {
+        close(fd);
+        return nullptr;
+    }
+    bool ok = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == base &&
+              mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == base + size;
+    close(fd);                  // 映射持有文件的引用
+    if(!ok) {
+        munmap(base, 2 * size);
+        return nullptr;
+    }
+    *cap = size;
+    inUseBytes.fetch_add(size, std::memory_order_relaxed);
+    return base;
+}
+
+void BufferPool::FreeMirror(char* block, size_t cap) {
+    assert(block);
+    inUseBytes.fetch_sub(cap, std::memory_order_relaxed);
+    if(cache.dead || cache.cachedBytes + cap > MAX_THREAD_CACHE) {
+        munmap(block, 2 * cap);
+        return;
+    }
+    (void)&reaper;
+    MirrorBlock* free = reinterpret_cast<MirrorBlock*>(block);
+    free->next = cache.mirrors;
+    free->cap = cap;
+    cache.mirrors = free;
+    cache.cachedBytes += cap;
+    pooledBytes.fetch_add(cap, std::memory_order_relaxed);
+}
+
+size_t BufferPool::PooledBytes() {
+    return pooledBytes.load(std::memory_order_relaxed);
+}
+
+size_t BufferPool::InUseBytes() {
+    return inUseBytes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+    Buffer存储空间的分级内存池：
+    - 块大小按2的幂分级（MIN_BLOCK到MAX_BLOCK），申请时向上取整到所属级别，扩容自然按倍数增长；
+    - 每个线程各有一份空闲链表，分配和归还不加锁；在一个线程申请、另一个线程归还的块进入归还线程的缓存；
+    - 每个线程缓存的空闲块总量不超过MAX_THREAD_CACHE，超出的和大于MAX_BLOCK的块直接还给系统；
+    - 线程退出时其缓存的空闲块全部释放。
+    镜像块：同一个memfd连续映射两次，块后紧跟着它自身的第二份映射，
+    环形缓冲区的可读和可写区域跨过块尾时仍是连续的地址；建立映射要多次系统调用，
+    归还的镜像块同样进入线程缓存（与普通块共用MAX_THREAD_CACHE），持续大量读入的连接
+    每次空闲后再变忙时直接取用，不再重新映射。
+*/
+
+class BufferPool {
+public:
+    // 申请至少len字节的块，实际大小写入*cap，归还时原样传回
+    static char* Alloc(size_t len, size_t* cap);
+    static void Free(char* block, size_t cap);
+    // 镜像块：大小取整为页大小的2的幂倍，[block, block + 2 * cap)都可访问；映射失败时返回nullptr
+    static char* AllocMirror(size_t len, size_t* cap);
+    static void FreeMirror(char* block, size_t cap);
+
+    // 统计：各线程缓存中的空闲字节数和已分配给缓冲区的字节数
+    static size_t PooledBytes();
+    static size_t InUseBytes();
+
+    static constexpr size_t MIN_BLOCK = 512;
+    static constexpr size_t MAX_BLOCK = 256 * 1024;
+    static constexpr int CLASS_NUM = 10;                        // 512B, 1K, ..., 256K
+    static constexpr size_t MAX_THREAD_CACHE = 4 * 1024 * 1024;
+
+private:
+    static int ClassOf_(size_t len);
+};
@@ -0,0 +1,197 @@
+#include "chainbuffer.h"
+
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+SlabPool* SlabPool::Instance() {
+    static SlabPool pool;
+    return &pool;
+}
+
+SlabPool::~SlabPool() {
+    for(char* slab : free_)
+        delete[] slab;
+}
+
+char* SlabPool::Get() {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if(!free_.empty()) {
+            char* slab = free_.back();
+            free_.pop_back();
+            return slab;
+        }
+    }
+    return new char[SLAB_SIZE];
+}
+
+void SlabPool::Put(char* slab) {
+    assert(slab);
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if(free_.size() < MAX_FREE) {
+            free_.push_back(slab);
+            return;
+        }
+    }
+    delete[] slab;
+}
+
+size_t SlabPool::FreeCount() {
+    std::lock_guard<std::mutex> locker(mtx_);
+    return free_.size();
+}
+
+
+ChainBuffer::~ChainBuffer() {
+    RetrieveAll();
+}
+
+void ChainBuffer::Append(const char* data, size_t len) {
+    while(len > 0) {
+        if(slabs_.empty() || slabs_.back().end == SlabPool::SLAB_SIZE)
+            slabs_.push_back({ SlabPool::Instance()->Get(), 0, 0 });
+        Slab &tail = slabs_.back();
+        size_t n = std::min(len, SlabPool::SLAB_SIZE - tail.end);
+        memcpy(tail.data + tail.end, data, n);
+        tail.end += n;
+        readable_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// 链尾剩余的空闲空间不再使用，换来数据不拷贝
+void ChainBuffer::Append(ChainBuffer &&other) {
+    if(&other == this || other.slabs_.empty())
+        return;
+    if(!slabs_.empty() && slabs_.back().begin == slabs_.back().end) {
+        SlabPool::Instance()->Put(slabs_.back().data);
+        slabs_.pop_back();
+    }
+    slabs_.insert(slabs_.end(), other.slabs_.begin(), other.slabs_.end());
+    readable_ += other.readable_;
+    other.slabs_.clear();
+    other.readable_ = 0;
+}
+
+char* ChainBuffer::AppendSpace(size_t len) {
+    assert(len <= SlabPool::SLAB_SIZE);
+    if(slabs_.empty() || SlabPool::SLAB_SIZE - slabs_.back().end < len)
+        slabs_.push_back({ SlabPool::Instance()->Get(), 0, 0 });
+    Slab &tail = slabs_.back();
+    char* space = tail.data + tail.end;
+    tail.end += len;
+    readable_ += len;
+    return space;
+}
+
+void ChainBuffer::Unwrite(size_t len) {
+    assert(!slabs_.empty() && slabs_.back().end - slabs_.back().begin >= len);
+    slabs_.back().end -= len;
+    readable_ -= len;
+}
+
+void ChainBuffer::Retrieve(size_t len) {
+    assert(len <= readable_);
+    readable_ -= len;
+    size_t done = 0;
+    while(len > 0) {
+        Slab &slab = slabs_[done];
+        size_t n = std::min(len, slab.end - slab.begin);
+        slab.begin += n;
+        len -= n;
+        // 读完且不会再写入的slab归还，链尾的slab还有空闲空间时留着继续写
+        if(slab.begin == slab.end && (slab.end == SlabPool::SLAB_SIZE || done + 1 < slabs_.size()))
+            SlabPool::Instance()->Put(slabs_[done++].data);
+    }
+    slabs_.erase(slabs_.begin(), slabs_.begin() + done);
+}
+
+void ChainBuffer::RetrieveAll() {
+    for(const Slab &slab : slabs_)
+        SlabPool::Instance()->Put(slab.data);
+    slabs_.clear();
+    readable_ = 0;
+}
+
+std::string ChainBuffer::RetrieveAllToStr() {
+    std::string str;
+    str.reserve(readable_);
+    for(const Slab &slab : slabs_)
+        str.append(slab.data + slab.begin, slab.end - slab.begin);
+    RetrieveAll();
+    return str;
+}
+
+int ChainBuffer::GetIov(struct iovec* iov, int max) const {
+    int cnt = 0;
+    for(size_t i = 0; i < slabs_.size() && cnt < max; i++) {
+        const Slab &slab = slabs_[i];
+        if(slab.end > slab.begin)
+            iov[cnt++] = { slab.data + slab.begin, slab.end - slab.begin };
+    }
+    return cnt;
+}
+
+// 先填满链尾的空闲空间，不够预留大小时再取新slab一起readv，没用上的新slab当即归还
+ssize_t ChainBuffer::ReadFd(int fd, int* saveErrno) {
+    const int MAX_FRESH = MAX_READ_HINT / SlabPool::SLAB_SIZE;
+    struct iovec iov[MAX_FRESH + 1];
+    int cnt = 0;
+    size_t capacity = 0;
+    if(!slabs_.empty() && slabs_.back().end < SlabPool::SLAB_SIZE) {
+        Slab &tail = slabs_.back();
+        iov[cnt++] = { tail.data + tail.end, SlabPool::SLAB_SIZE - tail.end };
+        capacity = SlabPool::SLAB_SIZE - tail.end;
+    }
+    const int tailIov = cnt;
+    while(capacity < readHint_ && cnt - tailIov < MAX_FRESH) {
+        iov[cnt++] = { SlabPool::Instance()->Get(), SlabPool::SLAB_SIZE };
+        capacity += SlabPool::SLAB_SIZE;
+    }
+
+    const ssize_t len = readv(fd, iov, cnt);
+    if(len < 0)
+        *saveErrno = errno;
+    size_t left = len > 0 ? len : 0;
+    readable_ += left;
+    if(tailIov > 0) {
+        size_t n = std::min(left, iov[0].iov_len);
+        slabs_.back().end += n;
+        left -= n;
+    }
+    for(int i = tailIov; i < cnt; i++) {
+        char* data = static_cast<char*>(iov[i].iov_base);
+        if(left > 0) {
+            size_t n = std::min(left, SlabPool::SLAB_SIZE);
+            slabs_.push_back({ data, 0, n });
+            left -= n;
+        }
+        else {
+            SlabPool::Instance()->Put(data);
+        }
+    }
+
+    if(len > 0 && static_cast<size_t>(len) >= capacity)
+        readHint_ = std::min(readHint_ * 2, MAX_READ_HINT);
+    else if(len > 0 && static_cast<size_t>(len) < readHint_ / 4)
+        readHint_ = std::max(readHint_ / 2, SlabPool::SLAB_SIZE);
+    return len;
+}
+
+ssize_t ChainBuffer::WriteFd(int fd, int* saveErrno) {
+    struct iovec iov[64];
+    int cnt = GetIov(iov, 64);
+    if(cnt == 0)
+        return 0;
+    ssize_t len = writev(fd, iov, cnt);
+    if(len < 0) {
+        *saveErrno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
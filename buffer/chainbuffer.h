@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <assert.h>
+
+/*
+    由定长slab串成的缓冲区：
+    - slab来自全局的SlabPool，用完归还，数据量变化时不realloc，也没有把数据搬回开头的整理操作；
+    - Append(ChainBuffer&&)把对方的slab直接接到链尾，不拷贝数据；
+    - ReadFd用一次readv读进链尾的空闲空间和若干个新slab，WriteFd直接用链上的各段writev；
+    - 写入的数据在取走之前地址不变，可以先占位、之后回填（如chunked编码的块长度）。
+    数据不连续，需要在整块数据上解析的场景（请求解析、HTTP/2帧）仍使用Buffer。
+*/
+
+class SlabPool {
+public:
+    static SlabPool* Instance();
+
+    char* Get();
+    void Put(char* slab);
+    size_t FreeCount();
+
+    static constexpr size_t SLAB_SIZE = 16 * 1024;
+    static constexpr size_t MAX_FREE = 1024;        // 空闲slab超过此数时直接释放
+
+private:
+    SlabPool() = default;
+    ~SlabPool();
+
+    std::mutex mtx_;
+    std::vector<char*> free_;
+};
+
+class ChainBuffer {
+public:
+    ChainBuffer(): readable_(0), readHint_(SlabPool::SLAB_SIZE) {}
+    ~ChainBuffer();
+
+    ChainBuffer(const ChainBuffer&) = delete;
+    ChainBuffer& operator=(const ChainBuffer&) = delete;
+
+    size_t ReadableBytes() const { return readable_; }
+    size_t SlabCount() const { return slabs_.size(); }
+
+    void Append(const char* data, size_t len);
+    void Append(std::string_view data) { Append(data.data(), data.size()); }
+    void Append(ChainBuffer &&other);       // 把other的数据整体接到末尾，other变为空
+    char* AppendSpace(size_t len);          // 在末尾追加len字节的连续空间（不超过SLAB_SIZE）并返回其地址，由调用方填写
+    void Unwrite(size_t len);               // 撤销最后写入的len字节，这些字节须在同一个slab中
+
+    void Retrieve(size_t len);              // 取走开头len字节，读完的slab归还给SlabPool
+    void RetrieveAll();
+    std::string RetrieveAllToStr();
+
+    // 从开头起依次填入可读数据的各段，最多max段，返回填入的段数
+    int GetIov(struct iovec* iov, int max) const;
+
+    ssize_t ReadFd(int fd, int* saveErrno);
+    ssize_t WriteFd(int fd, int* saveErrno);
+
+    // ReadFd预留的空间：读满时加倍，读到的远少于预留时减半，与Buffer的策略相同
+    static constexpr size_t MAX_READ_HINT = 16 * SlabPool::SLAB_SIZE;
+
+private:
+    struct Slab {
+        char* data;
+        size_t begin;       // 第一个未读字节
+        size_t end;         // 第一个空闲字节
+    };
+
+    std::vector<Slab> slabs_;
+    size_t readable_;
+    size_t readHint_;
+};
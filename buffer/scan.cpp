@@ -0,0 +1,193 @@
+#include "scan.h"
+
+#include <string.h>
+#include <assert.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Scan {
+
+namespace {
+
+typedef const char* (*FindByteFn)(const char*, const char*, char);
+typedef const char* (*FindAnyFn)(const char*, const char*, const char*, int);
+
+struct Kernels {
+    FindByteFn findByte;
+    FindAnyFn findAny;
+};
+
+// ---------------- 标量实现 ----------------
+
+const char* FindByteScalar(const char* begin, const char* end, char c) {
+    for(const char* p = begin; p < end; p++) {
+        if(*p == c)
+            return p;
+    }
+    return nullptr;
+}
+
+const char* FindAnyScalar(const char* begin, const char* end, const char* set, int setLen) {
+    for(const char* p = begin; p < end; p++) {
+        for(int i=0; i<setLen; i++) {
+            if(*p == set[i])
+                return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef SCAN_X86
+
+// ---------------- SSE4.2实现，每次16字节 ----------------
+
+__attribute__((target("sse4.2")))
+const char* FindByteSse42(const char* begin, const char* end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 16 <= end; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if(mask)
+            return p + __builtin_ctz(mask);
+    }
+    // 不足16字节的尾部逐字节处理，避免越界读
+    return FindByteScalar(p, end, c);
+}
+
+__attribute__((target("sse4.2")))
+const char* FindAnySse42(const char* begin, const char* end, const char* set, int setLen) {
+    char setBuf[16] = {0};
+    memcpy(setBuf, set, setLen);
+    const __m128i needles = _mm_loadu_si128(reinterpret_cast<const __m128i*>(setBuf));
+    const char* p = begin;
+    for(; p + 16 <= end; p += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int idx = _mm_cmpestri(needles, setLen, block, 16,
+                               _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if(idx < 16)
+            return p + idx;
+    }
+    return FindAnyScalar(p, end, set, setLen);
+}
+
+// ---------------- AVX2实现，每次32字节 ----------------
+
+__attribute__((target("avx2")))
+const char* FindByteAvx2(const char* begin, const char* end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 32 <= end; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if(mask)
+            return p + __builtin_ctz(mask);
+    }
+    return FindByteSse42(p, end, c);
+}
+
+// 集合中每个字符各比较一次再按位或，HTTP里用到的集合只有三四个字符
+__attribute__((target("avx2")))
+const char* FindAnyAvx2(const char* begin, const char* end, const char* set, int setLen) {
+    __m256i needles[16];
+    for(int i=0; i<setLen; i++)
+        needles[i] = _mm256_set1_epi8(set[i]);
+    const char* p = begin;
+    for(; p + 32 <= end; p += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_cmpeq_epi8(block, needles[0]);
+        for(int i=1; i<setLen; i++)
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(block, needles[i]));
+        unsigned mask = _mm256_movemask_epi8(hit);
+        if(mask)
+            return p + __builtin_ctz(mask);
+    }
+    return FindAnySse42(p, end, set, setLen);
+}
+
+#endif
+
+const Kernels KERNELS[] = {
+    { FindByteScalar, FindAnyScalar },
+#ifdef SCAN_X86
+    { FindByteSse42, FindAnySse42 },
+    { FindByteAvx2, FindAnyAvx2 },
+#endif
+};
+
+bool Supported(Impl impl) {
+#ifdef SCAN_X86
+    // 可能在其他全局对象的构造函数之前执行，需要先初始化CPU信息
+    __builtin_cpu_init();
+    if(impl == IMPL_AVX2)
+        return __builtin_cpu_supports("avx2");
+    if(impl == IMPL_SSE42)
+        return __builtin_cpu_supports("sse4.2");
+#endif
+    return impl == IMPL_SCALAR;
+}
+
+Impl Detect() {
+    if(Supported(IMPL_AVX2))
+        return IMPL_AVX2;
+    if(Supported(IMPL_SSE42))
+        return IMPL_SSE42;
+    return IMPL_SCALAR;
+}
+
+// 静态初始化阶段先用标量实现，动态初始化时再切换到CPU支持的最快实现
+Impl g_impl = IMPL_SCALAR;
+const Kernels* g_kernels = &KERNELS[IMPL_SCALAR];
+
+} // namespace
+
+const char* FindByte(const char* begin, const char* end, char c) {
+    assert(begin <= end);
+    return g_kernels->findByte(begin, end, c);
+}
+
+const char* FindAny(const char* begin, const char* end, const char* set, int setLen) {
+    assert(begin <= end && setLen > 0 && setLen <= 16);
+    return g_kernels->findAny(begin, end, set, setLen);
+}
+
+const char* FindCRLF(const char* begin, const char* end) {
+    const char* p = begin;
+    while((p = FindByte(p, end, '\r')) != nullptr) {
+        if(p + 1 >= end)
+            return nullptr;
+        if(p[1] == '\n')
+            return p;
+        p++;
+    }
+    return nullptr;
+}
+
+Impl Current() {
+    return g_impl;
+}
+
+bool Use(Impl impl) {
+    if(!Supported(impl))
+        return false;
+    g_impl = impl;
+    g_kernels = &KERNELS[impl];
+    return true;
+}
+
+namespace {
+const bool g_detected = Use(Detect());
+}
+
+const char* ImplName(Impl impl) {
+    switch(impl) {
+        case IMPL_AVX2:  return "avx2";
+        case IMPL_SSE42: return "sse4.2";
+        default:         return "scalar";
+    }
+}
+
+} // namespace Scan
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+    HTTP头部的分隔符扫描（行尾、冒号、空格等）：
+    - 提供AVX2、SSE4.2两套SIMD实现以及逐字节的标量实现；
+    - 第一次使用前按CPU支持的指令集选择最快的实现，之后所有调用都走函数指针；
+    - 所有函数在[begin, end)中查找，找不到时返回nullptr，不会读越过end。
+*/
+
+namespace Scan {
+
+enum Impl {
+    IMPL_SCALAR,
+    IMPL_SSE42,
+    IMPL_AVX2,
+};
+
+// 返回第一个等于c的位置
+const char* FindByte(const char* begin, const char* end, char c);
+
+// 返回第一个属于set的位置，set最多16个字符（SSE4.2 PCMPESTRI的上限）
+const char* FindAny(const char* begin, const char* end, const char* set, int setLen);
+
+// 返回第一个"\r\n"中'\r'的位置
+const char* FindCRLF(const char* begin, const char* end);
+
+// 当前使用的实现；强制切换只用于测试和基准，CPU不支持时返回false
+Impl Current();
+bool Use(Impl impl);
+const char* ImplName(Impl impl);
+
+} // namespace Scan
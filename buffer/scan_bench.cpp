@@ -0,0 +1,87 @@
+/*
+    头部分隔符扫描的微基准：比较标量、SSE4.2、AVX2三种实现。
+    构造1KB~4KB的典型浏览器请求头（大Cookie），按解析器的方式逐行找行尾和冒号。
+    g++ -std=c++17 -O2 scan_bench.cpp scan.cpp -o scan_bench
+*/
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "scan.h"
+
+static std::string MakeHeaders(size_t target) {
+    std::string s =
+        "GET /static/js/app.3f9a1c.js?v=20240101 HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 "
+        "(KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,"
+        "image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Referer: https://www.example.com/index.html\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n";
+    // 剩余部分用Cookie填满，每个cookie形如 k=v;
+    std::string cookie = "Cookie: ";
+    unsigned seed = 12345;
+    while(s.size() + cookie.size() + 4 < target) {
+        seed = seed * 1103515245 + 12345;
+        cookie += "_ga" + std::to_string(seed % 1000) + "=GA1.2.";
+        cookie += std::to_string(seed) + "." + std::to_string(seed >> 7) + "; ";
+    }
+    s += cookie + "\r\n\r\n";
+    return s;
+}
+
+// 与HttpRequest相同的扫描方式，返回找到的行数，防止被优化掉
+static int ScanBlock(const std::string &block) {
+    const char* p = block.data();
+    const char* end = p + block.size();
+    int lines = 0;
+    while(p < end) {
+        const char* eol = Scan::FindByte(p, end, '\n');
+        if(!eol)
+            break;
+        if(Scan::FindAny(p, eol, ": \t", 3))
+            lines++;
+        p = eol + 1;
+    }
+    return lines;
+}
+
+int main() {
+    const size_t sizes[] = { 1024, 2048, 4096 };
+    const Scan::Impl impls[] = { Scan::IMPL_SCALAR, Scan::IMPL_SSE42, Scan::IMPL_AVX2 };
+    const int ROUNDS = 200000;
+
+    printf("default impl: %s\n", Scan::ImplName(Scan::Current()));
+    printf("%-8s %-8s %12s %10s\n", "size", "impl", "ns/block", "GB/s");
+    for(size_t size : sizes) {
+        std::string block = MakeHeaders(size);
+        int expect = -1;
+        for(Scan::Impl impl : impls) {
+            if(!Scan::Use(impl)) {
+                printf("%-8zu %-8s %12s\n", block.size(), Scan::ImplName(impl), "unsupported");
+                continue;
+            }
+            int lines = ScanBlock(block);
+            if(expect >= 0 && lines != expect) {
+                printf("MISMATCH %s: %d vs %d\n", Scan::ImplName(impl), lines, expect);
+                return 1;
+            }
+            expect = lines;
+
+            long sum = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            for(int i=0; i<ROUNDS; i++)
+                sum += ScanBlock(block);
+            auto t1 = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / ROUNDS;
+            printf("%-8zu %-8s %12.1f %10.2f%s\n", block.size(), Scan::ImplName(impl),
+                   ns, block.size() / ns, sum == 0 ? " !" : "");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,386 @@
+#include "filecache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <zlib.h>
+#include <time.h>
+#include <stdio.h>
+
+#include "httpresponse.h"
+#include "../log/log.h"
+
+CachedFile::~CachedFile() {
+    delete gzip_.load();
+    if(data_)
+        munmap(data_, st_.st_size);
+    if(fd_ >= 0)
+        close(fd_);
+}
+
+FileCache::FileCache(): shardCapacity_(0), shardEntries_(0),
+        inotifyFd_(-1), stopFd_(-1), watching_(false) {}
+
+FileCache::~FileCache() {
+    Close();
+}
+
+FileCache* FileCache::Instance() {
+    static FileCache cache;
+    return &cache;
+}
+
+void FileCache::Init(const char* srcDir, size_t capacity, size_t maxEntries) {
+    assert(srcDir && capacity > 0 && maxEntries > 0);
+    Close();
+    srcDir_ = srcDir;
+    // srcDir以'/'结尾，请求路径以'/'开头，拼接前去掉一个
+    while(!srcDir_.empty() && srcDir_.back() == '/')
+        srcDir_.pop_back();
+    shardCapacity_ = capacity / SHARD_NUM;
+    shardEntries_ = (maxEntries + SHARD_NUM - 1) / SHARD_NUM;
+    compressPool_.reset(new ThreadPool(1));
+    if(!InitWatch_()) {
+        LOG_WARN("FileCache: inotify unavailable, validate by mtime");
+    }
+}
+
+void FileCache::Close() {
+    if(watchThread_) {
+        uint64_t one = 1;
+        if(write(stopFd_, &one, sizeof(one)) != sizeof(one)) {
+            LOG_WARN("FileCache: wakeup watcher error!");
+        }
+        watchThread_->join();
+        watchThread_.reset();
+    }
+    watching_ = false;
+    if(inotifyFd_ >= 0) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+    if(stopFd_ >= 0) {
+        close(stopFd_);
+        stopFd_ = -1;
+    }
+    watchDirs_.clear();
+    // 已排队的压缩任务只持有条目的weak_ptr，线程池关闭后自行结束
+    compressPool_.reset();
+    Clear();
+}
+
+FileCache::Shard& FileCache::ShardOf_(std::string_view path) {
+    return shards_[std::hash<std::string_view>()(path) & (SHARD_NUM - 1)];
+}
+
+FilePtr FileCache::Get(std::string_view path) {
+    assert(!srcDir_.empty());
+    // 含"//"或"/./"的路径与规范路径指向同一文件，但inotify无法按其键失效，不进缓存
+    bool cacheable = path.find("//") == std::string_view::npos &&
+                     path.find("/./") == std::string_view::npos;
+    Shard &shard = ShardOf_(path);
+    uint64_t generation = 0;
+    if(cacheable) {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        generation = shard.generation;
+        auto found = shard.index.find(path);
+        if(found != shard.index.end()) {
+            auto it = found->second;
+            if(!IsStale_(**it)) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it);
+                return *it;
+            }
+            Erase_(shard, it);
+        }
+    }
+
+    // 未命中时在锁外打开文件，避免阻塞同一分片上的其他请求
+    FilePtr file = Load_(path);
+    if(!file || !cacheable)
+        return file;
+
+    std::lock_guard<std::mutex> locker(shard.mtx);
+    auto found = shard.index.find(path);
+    if(found != shard.index.end()) {
+        // 其他线程已经加载过，用已有的条目
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        return *found->second;
+    }
+    // 加载期间有过失效（inotify事件来时还没有条目可删），加载到的可能是旧内容，只用于本次响应
+    if(shard.generation != generation)
+        return file;
+    shard.lru.push_front(file);
+    shard.index[file->Path()] = shard.lru.begin();
+    shard.bytes += file->Data() ? file->Size() : 0;
+    // 淘汰最久未使用的条目，正在发送的响应仍持有shared_ptr，不受影响
+    while(shard.lru.size() > 1 &&
+          (shard.bytes > shardCapacity_ || shard.lru.size() > shardEntries_)) {
+        Erase_(shard, std::prev(shard.lru.end()));
+    }
+    return file;
+}
+
+FilePtr FileCache::Load_(std::string_view path) {
+    std::string fullPath = srcDir_;
+    fullPath.append(path.data(), path.size());
+    int fd = open(fullPath.data(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return nullptr;
+
+    std::shared_ptr<CachedFile> file(new CachedFile());
+    file->fd_ = fd;
+    if(fstat(fd, &file->st_) < 0 || !S_ISREG(file->st_.st_mode))
+        return nullptr;
+    file->path_.assign(path.data(), path.size());
+
+    size_t size = file->st_.st_size;
+    if(size > 0 && size <= MAX_MAP_SIZE) {
+        void* ret = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(ret != MAP_FAILED)
+            file->data_ = static_cast<char*>(ret);
+    }
+    file->mime_ = HttpResponse::GetMimeType(path);
+    file->compressible_ = IsCompressibleType_(file->mime_);
+    InitValidators_(*file);
+    file->header_ = "Content-type: " + file->mime_ + "\r\n" + file->validators_ +
+                    "Accept-Ranges: bytes\r\n" + "Content-length: " + std::to_string(size) + "\r\n\r\n";
+
+    // 同目录下有预压缩的.gz文件时直接作为gzip变体
+    if(file->compressible_) {
+        std::string gzPath(path.data(), path.size());
+        gzPath += ".gz";
+        FilePtr gz = Get(gzPath);
+        if(gz && gz->IsReadable()) {
+            EncodedFile* enc = new EncodedFile();
+            enc->file = gz;
+            InitEncoded_(*file, *enc);
+            file->gzip_.store(enc);
+            file->gzipQueued_ = true;
+        }
+    }
+    return file;
+}
+
+bool FileCache::IsCompressibleType_(const std::string &mime) {
+    return mime.compare(0, 5, "text/") == 0 ||
+           mime.find("xml") != std::string::npos ||
+           mime.find("javascript") != std::string::npos ||
+           mime.find("json") != std::string::npos;
+}
+
+// ETag由修改时间和大小生成，Last-Modified为HTTP-date；可压缩的资源按Accept-Encoding
+// 返回不同内容，还需要Vary告诉缓存服务器
+void FileCache::InitValidators_(CachedFile &file) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx\"",
+             static_cast<unsigned long>(file.st_.st_mtime), static_cast<unsigned long>(file.st_.st_size));
+    file.etag_ = buf;
+
+    struct tm tm;
+    gmtime_r(&file.st_.st_mtime, &tm);
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    file.validators_ = "ETag: " + file.etag_ + "\r\nLast-Modified: " + buf + "\r\n";
+    if(file.compressible_)
+        file.validators_ += "Vary: Accept-Encoding\r\n";
+}
+
+void FileCache::InitEncoded_(const CachedFile &file, EncodedFile &enc) {
+    // 在原文件的ETag引号内加上-gz
+    enc.etag = file.etag_;
+    enc.etag.insert(enc.etag.size() - 1, "-gz");
+    enc.validators = file.validators_;
+    enc.validators.replace(6, file.etag_.size(), enc.etag);
+    enc.header = "Content-type: " + file.mime_ + "\r\nContent-Encoding: gzip\r\n" + enc.validators +
+                 "Content-length: " + std::to_string(enc.Size()) + "\r\n\r\n";
+}
+
+const EncodedFile* FileCache::GetGzip(const FilePtr &file) {
+    assert(file);
+    const EncodedFile* enc = file->gzip_.load(std::memory_order_acquire);
+    if(enc || !file->compressible_ || !file->Data() || file->Size() < MIN_GZIP_SIZE)
+        return enc;
+    // 每个条目只压缩一次，压缩完成前仍发送原文件
+    if(compressPool_ && !file->gzipQueued_.exchange(true)) {
+        std::weak_ptr<const CachedFile> weak = file;
+        compressPool_->AddTask([weak] {
+            FilePtr f = weak.lock();
+            if(f)
+                Compress_(*f);
+        });
+    }
+    return nullptr;
+}
+
+// 在后台线程中运行，压缩效果不明显时不生成变体
+void FileCache::Compress_(const CachedFile &file) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits加16输出gzip格式
+    if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return;
+    std::string out(deflateBound(&zs, file.Size()), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(file.Data()));
+    zs.avail_in = file.Size();
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    if(ret != Z_STREAM_END || out.size() >= file.Size() * 9 / 10) {
+        LOG_DEBUG("FileCache: skip gzip for %s", file.Path().data());
+        return;
+    }
+
+    EncodedFile* enc = new EncodedFile();
+    enc->data.swap(out);
+    InitEncoded_(file, *enc);
+    file.gzip_.store(enc, std::memory_order_release);
+    LOG_DEBUG("FileCache: gzip %s %zu -> %zu", file.Path().data(), file.Size(), enc->data.size());
+}
+
+// 有inotify时条目由监视线程失效；否则比较一次文件的修改时间和大小
+bool FileCache::IsStale_(const CachedFile &file) {
+    if(watching_)
+        return false;
+    struct stat st;
+    if(stat((srcDir_ + file.Path()).data(), &st) < 0)
+        return true;
+    return st.st_mtim.tv_sec != file.st_.st_mtim.tv_sec ||
+           st.st_mtim.tv_nsec != file.st_.st_mtim.tv_nsec ||
+           st.st_size != file.st_.st_size || st.st_ino != file.st_.st_ino;
+}
+
+void FileCache::Erase_(Shard &shard, std::list<FilePtr>::iterator it) {
+    shard.bytes -= (*it)->Data() ? (*it)->Size() : 0;
+    shard.index.erase((*it)->Path());
+    shard.lru.erase(it);
+}
+
+void FileCache::Invalidate(const std::string &path) {
+    {
+        Shard &shard = ShardOf_(path);
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        shard.generation++;
+        auto found = shard.index.find(path);
+        if(found != shard.index.end()) {
+            LOG_DEBUG("FileCache: invalidate %s", path.data());
+            Erase_(shard, found->second);
+        }
+    }
+    // .gz文件变化时，以它为gzip变体的原文件条目也要失效
+    if(path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0)
+        Invalidate(path.substr(0, path.size() - 3));
+}
+
+void FileCache::Clear() {
+    for(Shard &shard : shards_) {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+        shard.generation++;
+    }
+}
+
+size_t FileCache::Count() {
+    size_t count = 0;
+    for(Shard &shard : shards_) {
+        std::lock_guard<std::mutex> locker(shard.mtx);
+        count += shard.lru.size();
+    }
+    return count;
+}
+
+bool FileCache::InitWatch_() {
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(inotifyFd_ < 0 || stopFd_ < 0 || !AddWatch_("")) {
+        return false;
+    }
+    watching_ = true;
+    watchThread_.reset(new std::thread([this] { Watch_(); }));
+    return true;
+}
+
+// inotify不递归，逐层为子目录添加监视；dir为相对资源目录的路径，根目录为""
+bool FileCache::AddWatch_(const std::string &dir) {
+    std::string fullPath = srcDir_ + dir;
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+    int wd = inotify_add_watch(inotifyFd_, fullPath.data(), mask);
+    if(wd < 0) {
+        LOG_WARN("FileCache: watch %s error:%d", fullPath.data(), errno);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> locker(watchMtx_);
+        watchDirs_[wd] = dir;
+    }
+
+    DIR* dp = opendir(fullPath.data());
+    if(!dp)
+        return true;
+    struct dirent* entry;
+    while((entry = readdir(dp)) != nullptr) {
+        if(entry->d_type != DT_DIR || strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        AddWatch_(dir + "/" + entry->d_name);
+    }
+    closedir(dp);
+    return true;
+}
+
+void FileCache::Watch_() {
+    alignas(struct inotify_event) char buf[4096];
+    struct pollfd fds[2] = { { inotifyFd_, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+    while(true) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        if(fds[1].revents)
+            break;
+
+        ssize_t len;
+        while((len = read(inotifyFd_, buf, sizeof(buf))) > 0) {
+            for(char* p = buf; p < buf + len; ) {
+                struct inotify_event* ev = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + ev->len;
+
+                if(ev->mask & IN_Q_OVERFLOW) {
+                    // 事件丢失，无法知道哪些文件变了
+                    Clear();
+                    continue;
+                }
+                std::string dir;
+                {
+                    std::lock_guard<std::mutex> locker(watchMtx_);
+                    auto found = watchDirs_.find(ev->wd);
+                    if(found == watchDirs_.end())
+                        continue;
+                    dir = found->second;
+                    if(ev->mask & IN_IGNORED)
+                        watchDirs_.erase(found);
+                }
+                if(ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                    Clear();
+                }
+                else if(ev->len > 0 && (ev->mask & IN_ISDIR)) {
+                    // 目录移走或删除时其下的条目都失效；新建或移入的目录补上监视
+                    if(ev->mask & (IN_DELETE | IN_MOVED_FROM))
+                        Clear();
+                    if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+                        AddWatch_(dir + "/" + ev->name);
+                }
+                else if(ev->len > 0) {
+                    Invalidate(dir + "/" + ev->name);
+                }
+            }
+        }
+    }
+}
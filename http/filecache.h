@@ -0,0 +1,163 @@
+# pragma once
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "../pool/treadpool.h"
+
+/*
+    进程内共享的静态文件缓存：
+    - 以资源目录下的请求路径为键，缓存已打开的文件描述符、小文件的只读映射、
+      元数据（大小、修改时间、权限）以及预先生成的Content-type/Content-length头；
+    - 分成SHARD_NUM个分片，每个分片一把锁、一条LRU链，按映射字节数和条目数限制大小；
+    - 用inotify监视资源目录，文件被修改、删除、移动时使对应条目失效；
+      inotify不可用时退回为每次命中比较一次mtime。
+    命中时不需要任何文件系统调用。
+    文本类文件还可以带一个gzip变体：同目录下存在.gz文件时直接使用，
+    否则第一次被支持gzip的客户端请求时交给后台线程压缩，结果保存在条目中。
+    小文件的条目还保存拼好的完整响应（PrebuiltResponse），HTTP/1.1连接命中时整块发送。
+*/
+
+class CachedFile;
+struct EncodedFile;
+struct PrebuiltResponse;
+typedef std::shared_ptr<const CachedFile> FilePtr;
+typedef std::shared_ptr<const PrebuiltResponse> PrebuiltPtr;
+
+class CachedFile {
+public:
+    ~CachedFile();
+
+    CachedFile(const CachedFile&) = delete;
+    CachedFile& operator=(const CachedFile&) = delete;
+
+    const std::string& Path() const { return path_; }
+    int Fd() const { return fd_; }
+    size_t Size() const { return st_.st_size; }
+    const struct stat& Stat() const { return st_; }
+    bool IsReadable() const { return st_.st_mode & S_IROTH; }
+    const char* Data() const { return data_; }          // 大文件不映射，为nullptr
+    const std::string& MimeType() const { return mime_; }
+    const std::string& Header() const { return header_; }   // Content-type、校验器、Accept-Ranges、Content-length和空行
+    const std::string& ETag() const { return etag_; }
+    const std::string& Validators() const { return validators_; }  // 304响应使用的ETag、Last-Modified等头部
+    bool IsCompressible() const { return compressible_; }
+
+    // 小文件拼好的完整响应，按变体（是否gzip、是否保持连接）各存一份，由HttpResponse生成和替换
+    static const int PREBUILT_VARIANTS = 4;
+    PrebuiltPtr Prebuilt(int variant) const { return std::atomic_load(&prebuilt_[variant]); }
+    void SetPrebuilt(int variant, PrebuiltPtr resp) const { std::atomic_store(&prebuilt_[variant], std::move(resp)); }
+
+private:
+    friend class FileCache;
+    CachedFile(): fd_(-1), data_(nullptr), compressible_(false), gzip_(nullptr), gzipQueued_(false) {}
+
+    std::string path_;
+    int fd_;
+    char* data_;
+    struct stat st_;
+    std::string mime_;
+    std::string etag_;
+    std::string validators_;
+    std::string header_;
+
+    // gzip变体只发布一次，之后不再修改，随条目一起释放
+    bool compressible_;
+    mutable std::atomic<const EncodedFile*> gzip_;
+    mutable std::atomic<bool> gzipQueued_;
+
+    mutable PrebuiltPtr prebuilt_[PREBUILT_VARIANTS];
+};
+
+// 文件的gzip表示：预压缩的.gz文件或内存中的压缩结果
+struct EncodedFile {
+    FilePtr file;
+    std::string data;
+    std::string etag;          // 与原文件不同，以便区分两种表示
+    std::string validators;
+    std::string header;        // 含Content-Encoding、Vary的头部
+
+    int Fd() const { return file ? file->Fd() : -1; }
+    size_t Size() const { return file ? file->Size() : data.size(); }
+    const char* Data() const { return file ? file->Data() : data.data(); }
+};
+
+// 状态行到响应体结尾连续存放的完整200响应（不含逐个请求变化的Keep-Alive头），
+// 生成后不再修改，发送期间由响应对象持有引用；Date头的秒数变化后生成新的一份替换旧的
+struct PrebuiltResponse {
+    std::string data;
+    size_t dateOff;             // Date头在data中的位置
+    size_t headerLen;           // 响应头（含空行）的长度，HEAD请求只发送这一部分
+    int keepAliveTimeout;       // 拼入的Keep-Alive头中的超时，0表示没有该头
+};
+
+class FileCache {
+public:
+    static FileCache* Instance();
+
+    // capacity为所有分片映射字节数之和的上限
+    void Init(const char* srcDir, size_t capacity = 64 * 1024 * 1024, size_t maxEntries = 8192);
+    void Close();
+
+    // path为资源目录下以'/'开头的路径；文件不存在、不是普通文件或无法打开时返回nullptr
+    FilePtr Get(std::string_view path);
+    // 返回file的gzip变体；还没有时安排后台压缩并返回nullptr，本次先发送原文件
+    const EncodedFile* GetGzip(const FilePtr &file);
+
+    void Invalidate(const std::string &path);
+    void Clear();
+
+    size_t Count();
+
+    static const int SHARD_NUM = 16;
+    static const size_t MAX_MAP_SIZE = 1024 * 1024;     // 超过此大小的文件只缓存描述符和元数据
+    static const size_t MIN_GZIP_SIZE = 256;            // 太小的文件压缩得不偿失
+
+private:
+    FileCache();
+    ~FileCache();
+
+    struct Shard {
+        std::mutex mtx;
+        std::list<FilePtr> lru;          // 表头为最近使用
+        std::unordered_map<std::string_view, std::list<FilePtr>::iterator> index;
+        size_t bytes = 0;
+        uint64_t generation = 0;         // 每次失效加一，锁外加载的文件据此判断期间是否有过失效
+    };
+
+    Shard& ShardOf_(std::string_view path);
+    FilePtr Load_(std::string_view path);
+    static bool IsCompressibleType_(const std::string &mime);
+    static void InitValidators_(CachedFile &file);
+    static void InitEncoded_(const CachedFile &file, EncodedFile &enc);
+    static void Compress_(const CachedFile &file);
+    bool IsStale_(const CachedFile &file);
+    void Erase_(Shard &shard, std::list<FilePtr>::iterator it);
+
+    bool InitWatch_();
+    bool AddWatch_(const std::string &dir);
+    void Watch_();
+
+    std::string srcDir_;
+    size_t shardCapacity_;
+    size_t shardEntries_;
+    Shard shards_[SHARD_NUM];
+
+    // inotify监视
+    int inotifyFd_;
+    int stopFd_;
+    std::atomic<bool> watching_;
+    std::mutex watchMtx_;
+    std::unordered_map<int, std::string> watchDirs_;    // wd -> 相对资源目录的目录路径
+    std::unique_ptr<std::thread> watchThread_;
+
+    std::unique_ptr<ThreadPool> compressPool_;      // 后台压缩线程
+};
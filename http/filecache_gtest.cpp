@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "filecache.h"
+
+class FileCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/filecache_gtestXXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+        FileCache::Instance()->Init(dir_.c_str());
+    }
+
+    void TearDown() override {
+        FileCache::Instance()->Close();
+        unlink((dir_ + "/page.txt").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    // 先写临时文件再rename，与部署工具替换文件的方式相同，已打开的旧文件内容不变
+    void Replace(const std::string &name, const std::string &content) {
+        std::string tmp = dir_ + "/.tmp";
+        FILE* fp = fopen(tmp.c_str(), "w");
+        ASSERT_NE(fp, nullptr);
+        fwrite(content.data(), 1, content.size(), fp);
+        fclose(fp);
+        ASSERT_EQ(rename(tmp.c_str(), (dir_ + name).c_str()), 0);
+    }
+
+    static std::string Content(const FilePtr &file) {
+        return file ? std::string(file->Data(), file->Size()) : std::string();
+    }
+
+    std::string dir_;
+};
+
+TEST_F(FileCacheTest, HitAndInvalidate) {
+    FileCache* cache = FileCache::Instance();
+    Replace("/page.txt", "first version");
+    FilePtr a = cache->Get("/page.txt");
+    ASSERT_TRUE(a);
+    EXPECT_EQ(Content(a), "first version");
+    EXPECT_EQ(cache->Get("/page.txt"), a);
+    EXPECT_EQ(cache->Count(), 1u);
+
+    Replace("/page.txt", "second version!");
+    cache->Invalidate("/page.txt");
+    EXPECT_EQ(Content(cache->Get("/page.txt")), "second version!");
+    // 旧条目仍由a持有，内容不变
+    EXPECT_EQ(Content(a), "first version");
+    EXPECT_FALSE(cache->Get("/missing.txt"));
+}
+
+/*
+    未命中的加载在分片锁外进行：文件在加载期间被替换时，失效发生在条目插入之前，
+    没有东西可删；加载到的旧内容不能再进入缓存，否则之后一直返回旧版本。
+    读线程不停地未命中，写线程替换文件后像inotify线程一样调用Invalidate，
+    每一轮结束后缓存必须返回最新内容
+*/
+TEST_F(FileCacheTest, InvalidateDuringLoad) {
+    FileCache* cache = FileCache::Instance();
+    const int ROUNDS = 200;
+    const int READERS = 3;
+    for(int round = 0; round < ROUNDS; round++) {
+        std::string old = "version " + std::to_string(round);
+        std::string latest = "version " + std::to_string(round) + " updated";
+        Replace("/page.txt", old);
+        cache->Invalidate("/page.txt");
+
+        std::atomic<int> started(0);
+        std::atomic<bool> done(false);
+        std::vector<std::thread> readers;
+        for(int i = 0; i < READERS; i++) {
+            readers.emplace_back([&] {
+                started++;
+                while(!done.load()) {
+                    // 持续制造未命中，让加载与替换重叠
+                    cache->Invalidate("/page.txt");
+                    cache->Get("/page.txt");
+                }
+                cache->Get("/page.txt");
+            });
+        }
+        while(started.load() < READERS) {}
+        Replace("/page.txt", latest);
+        cache->Invalidate("/page.txt");
+        done = true;
+        for(std::thread &t : readers)
+            t.join();
+        ASSERT_EQ(Content(cache->Get("/page.txt")), latest) << "round " << round;
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
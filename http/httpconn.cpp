@@ -1,14 +1,26 @@
 #include "httpconn.h"
+#include "router.h"
 using namespace std;
 
 const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+bool HttpConn::useSendfile = true;
+int HttpConn::idleTimeoutMs = 0;
+int HttpConn::maxConn = 65536;
 
 HttpConn::HttpConn() { 
     fd_ = -1;
     addr_ = { 0 };
     isClose_ = true;
+    isKeepAlive_ = false;
+    requestCnt_ = 0;
+    handlerPending_ = false;
+    iovIdx_ = 0;
+    fileIdx_ = 0;
+    toWrite_ = 0;
+    streamIov_ = 0;
+    respCnt_ = 0;
 };
 
 HttpConn::~HttpConn() { 
@@ -20,19 +32,30 @@ void HttpConn::init(int fd, const sockaddr_in& addr) {
     userCount++;
     addr_ = addr;
     fd_ = fd;
-    writeBuff_.RetrieveAll();
-    readBuff_.RetrieveAll();
+    readBuff_.ReleaseStorage();
+    readBuff_.ResetReadHint();
+    request_.reset();
+    ReleaseResponses_();
+    h2_.reset();
+    isKeepAlive_ = false;
+    requestCnt_ = 0;
+    handlerPending_ = false;
     isClose_ = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close() {
-    response_.UnmapFile();
+    ReleaseResponses_();
+    h2_.reset();
+    readBuff_.ReleaseStorage();
+    ReleaseIdle_();
     if(isClose_ == false){
         isClose_ = true; 
         userCount--;
+        // fd关闭后可能立刻被复用，日志要在close之前读取连接信息
+        LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d, buffer in use:%zuKB pooled:%zuKB", fd_, GetIP(), GetPort(),
+                 (int)userCount, BufferPool::InUseBytes() / 1024, BufferPool::PooledBytes() / 1024);
         close(fd_);
-        LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
     }
 }
 
@@ -54,65 +77,316 @@ int HttpConn::GetPort() const {
 
 ssize_t HttpConn::read(int* saveErrno) {
     ssize_t len = -1;
+    size_t total = 0;
     do {
         len = readBuff_.ReadFd(fd_, saveErrno);
         if (len <= 0) {
             break;
         }
+        total += len;
     } while (isET);
+    // 一次就绪读到的数据或读入预留达到上限，说明数据持续大量到达（大请求体、HTTP/2上传），
+    // 改用镜像环形缓冲区，之后边读边解析不再搬动数据；连接空闲时随ReleaseStorage()恢复
+    if(!readBuff_.IsMirrored() && (total >= MIRROR_READ_BYTES || readBuff_.ReadHint() == Buffer::MAX_READ_HINT))
+        readBuff_.EnableMirror();
     return len;
 }
 
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;
     do {
-        len = writev(fd_, iov_, iovCnt_);
-        if(len <= 0) {
+        if(iov_[iovIdx_].iov_base == nullptr)
+            len = SendFile_(saveErrno);
+        else if((len = writev(fd_, GetIov(), GetIovCnt())) < 0)
             *saveErrno = errno;
+        if(len <= 0) {
             break;
         }
-        if(iov_[0].iov_len + iov_[1].iov_len  == 0) { break; } /* 传输结束 */
-        else if(static_cast<size_t>(len) > iov_[0].iov_len) {
-            iov_[1].iov_base = (uint8_t*) iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if(iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
+        Advance(len);
+        if(ToWriteBytes() == 0) { break; } /* 传输结束 */
+    } while(isET || ToWriteBytes() > 10240);
+    return len;
+}
+
+// 文件内容不经过用户态，偏移由files_记录，共享的文件描述符也不受影响；
+// 失败时错误码写入*saveErrno，回退路径中的日志调用不会覆盖它
+ssize_t HttpConn::SendFile_(int* saveErrno) {
+    FileSeg &seg = files_[fileIdx_];
+    off_t offset = seg.offset;
+    ssize_t len = sendfile(fd_, seg.resp->FileFd(), &offset, iov_[iovIdx_].iov_len);
+    if(len >= 0)
+        return len;
+    *saveErrno = errno;
+    if((*saveErrno == EINVAL || *saveErrno == ENOSYS) && seg.resp->MapFile()) {
+        // 文件系统不支持sendfile时退回mmap，剩余部分改为内存段
+        LOG_WARN("sendfile unsupported, fall back to mmap");
+        iov_[iovIdx_].iov_base = seg.resp->File() + seg.offset;
+        fileIdx_++;
+        len = writev(fd_, GetIov(), GetIovCnt());
+        if(len < 0)
+            *saveErrno = errno;
+    }
+    return len;
+}
+
+int HttpConn::GetIovCnt() const {
+    size_t cnt = 0;
+    while(iovIdx_ + cnt < iov_.size() && cnt < IOV_MAX && iov_[iovIdx_ + cnt].iov_base)
+        cnt++;
+    return static_cast<int>(cnt);
+}
+
+void HttpConn::Advance(size_t len) {
+    assert(len <= toWrite_);
+    toWrite_ -= len;
+    while(len > 0 && iovIdx_ < iov_.size()) {
+        struct iovec &iov = iov_[iovIdx_];
+        size_t n = len < iov.iov_len ? len : iov.iov_len;
+        if(iov.iov_base)
+            iov.iov_base = (uint8_t*)iov.iov_base + n;
+        else
+            files_[fileIdx_].offset += n;
+        iov.iov_len -= n;
+        len -= n;
+        if(iov.iov_len == 0) {
+            if(!iov.iov_base)
+                fileIdx_++;
+            iovIdx_++;
+        }
+    }
+    // 整批发送完后才回收writeBuff_和文件，发送期间iov_一直指向它们；
+    // 流式响应只剩streamBuff_中的数据时就可以继续产生
+    if(toWrite_ <= STREAM_LOW_WATER && iovIdx_ >= streamIov_ && IsStreaming_())
+        RefillStream_();
+    else if(toWrite_ == 0)
+        ReleaseResponses_();
+}
+
+bool HttpConn::IsStreaming_() const {
+    return respCnt_ > 0 && responses_[respCnt_ - 1]->IsStreaming();
+}
+
+// 流式响应总是一批中的最后一个，此时前面的响应和writeBuff_都已发完，只保留它和未发送的响应体
+void HttpConn::RefillStream_() {
+    std::swap(responses_[0], responses_[respCnt_ - 1]);
+    for(int i=1; i<respCnt_; i++)
+        responses_[i]->ReleaseFile();
+    respCnt_ = 1;
+    refs_.clear();
+    files_.clear();
+    fileIdx_ = 0;
+    writeBuff_.RetrieveAll();
+    streamBuff_.Retrieve(streamBuff_.ReadableBytes() - toWrite_);
+
+    responses_[0]->FillStream(streamBuff_, STREAM_HIGH_WATER);
+    iov_.clear();
+    iovIdx_ = 0;
+    streamIov_ = 0;
+    toWrite_ = 0;
+    AppendStreamIov_();
+    if(toWrite_ == 0)
+        ReleaseResponses_();
+}
+
+// streamBuff_的每个slab一个iovec，直接从slab发送
+void HttpConn::AppendStreamIov_() {
+    streamIov_ = iov_.size();
+    iov_.resize(streamIov_ + streamBuff_.SlabCount());
+    int cnt = streamBuff_.GetIov(iov_.data() + streamIov_, streamBuff_.SlabCount());
+    iov_.resize(streamIov_ + cnt);
+    toWrite_ += streamBuff_.ReadableBytes();
+}
+
+void HttpConn::AppendRead(const char* data, size_t len) {
+    readBuff_.Append(data, len);
+}
+
+HttpResponse& HttpConn::NextResponse_() {
+    if(respCnt_ == static_cast<int>(responses_.size())) {
+        responses_.emplace_back(new HttpResponse());
+    }
+    return *responses_[respCnt_++];
+}
+
+void HttpConn::ReleaseResponses_() {
+    for(int i=0; i<respCnt_; i++)
+        responses_[i]->ReleaseFile();
+    respCnt_ = 0;
+    writeBuff_.RetrieveAll();
+    iov_.clear();
+    iovIdx_ = 0;
+    refs_.clear();
+    files_.clear();
+    fileIdx_ = 0;
+    toWrite_ = 0;
+    streamBuff_.RetrieveAll();
+    streamIov_ = 0;
+}
+
+/*
+    没有待发送的响应、等待新请求时调用：输出缓冲区和本批的响应对象都已用完，
+    输入缓冲区在没有未解析完的请求时一并释放，空闲的连接只剩HttpConn本身
+*/
+void HttpConn::ReleaseIdle_() {
+    assert(toWrite_ == 0);
+    writeBuff_.ReleaseStorage();
+    if(readBuff_.ReadableBytes() == 0) {
+        readBuff_.ReleaseStorage();
+        request_.reset();
+    }
+    responses_.clear();
+    responses_.shrink_to_fit();
+    iov_.shrink_to_fit();
+    refs_.shrink_to_fit();
+    files_.shrink_to_fit();
+}
+
+// writeBuff_中两个文件段之间的内容是连续的，跨响应合并成一个iovec
+void HttpConn::BuildIov_() {
+    const char* head = writeBuff_.Peek();
+    size_t segBegin = 0;
+    for(const FileRef &ref : refs_) {
+        HttpResponse &resp = *ref.resp;
+        if(ref.bufEnd > segBegin)
+            iov_.push_back({ const_cast<char*>(head + segBegin), ref.bufEnd - segBegin });
+        // 内存中的压缩结果没有文件描述符，只能writev；
+        // HTTP/2的文件内容被帧头切成小段，已在缓存中映射的文件也直接writev，免得每帧一次sendfile
+        bool inMemory = (!useSendfile || resp.FileFd() < 0 || (h2_ && resp.IsFileCached())) && resp.MapFile();
+        if(inMemory) {
+            iov_.push_back({ resp.File() + ref.offset, ref.len });
         }
         else {
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len; 
-            iov_[0].iov_len -= len; 
-            writeBuff_.Retrieve(len);
+            iov_.push_back({ nullptr, ref.len });
+            files_.push_back({ &resp, static_cast<off_t>(ref.offset) });
         }
-    } while(isET || ToWriteBytes() > 10240);
-    return len;
+        segBegin = ref.bufEnd;
+    }
+    if(segBegin < writeBuff_.ReadableBytes())
+        iov_.push_back({ const_cast<char*>(head + segBegin), writeBuff_.ReadableBytes() - segBegin });
+    for(const struct iovec &iov : iov_)
+        toWrite_ += iov.iov_len;
+    AppendStreamIov_();
+}
+
+bool HttpConn::process(bool runHandlers) {
+    // 上一批还没发完时不处理新请求，保证响应顺序
+    assert(toWrite_ == 0);
+    ReleaseResponses_();
+    handlerPending_ = false;
+    // 以连接前言开头的是直接使用HTTP/2的客户端（prior knowledge），只收到一部分时先等待
+    if(!h2_ && readBuff_.ReadableBytes() > 0) {
+        size_t n = std::min(readBuff_.ReadableBytes(), Http2Session::PREFACE_LEN);
+        if(memcmp(readBuff_.Peek(), Http2Session::PREFACE, n) == 0) {
+            if(n < Http2Session::PREFACE_LEN)
+                return false;
+            StartHttp2_();
+        }
+    }
+    if(h2_)
+        return ProcessHttp2_(runHandlers);
+
+    if(!request_ && readBuff_.ReadableBytes() > 0)
+        request_.reset(new HttpRequest());
+    while(respCnt_ < MAX_PIPELINE && readBuff_.ReadableBytes() > 0) {
+        HttpRequest::PARSE_RESULT ret = request_->parse(readBuff_);
+        if(ret == HttpRequest::PARSE_AGAIN)
+            break;
+        // 请求留在readBuff_中，前面的响应照常发送，下次在线程池中从它开始处理
+        if(ret == HttpRequest::PARSE_OK && !runHandlers &&
+           HttpRouter::Find(request_->method(), request_->path())) {
+            handlerPending_ = true;
+            break;
+        }
+
+        // Upgrade: h2c只在本批第一个请求上处理，前面的响应发完后再升级
+        if(ret == HttpRequest::PARSE_OK && Http2Session::IsUpgradeRequest(*request_)) {
+            if(respCnt_ > 0)
+                break;
+            writeBuff_.Append("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+            StartHttp2_();
+            h2_->Upgrade(*request_, writeBuff_);
+            readBuff_.Retrieve(request_->Length());
+            request_->Init();
+            return ProcessHttp2_(runHandlers);
+        }
+
+        HttpResponse &resp = NextResponse_();
+        requestCnt_++;
+        // 响应需要读取请求头，先生成响应再从readBuff_中取走请求
+        if(ret == HttpRequest::PARSE_OK) {
+            LOG_DEBUG("%.*s", (int)request_->path().size(), request_->path().data());
+            bool keepAlive = request_->IsKeepAlive() && requestCnt_ < MAX_KEEPALIVE_REQUESTS;
+            resp.Init(srcDir, request_->path(), keepAlive, 200);
+            if(keepAlive)
+                resp.SetKeepAlive(IdleTimeoutMs() / 1000);
+            resp.EnablePrebuilt();
+            resp.MakeResponse(writeBuff_, request_.get());
+            readBuff_.Retrieve(request_->Length());
+        } else {
+            resp.Init(srcDir, request_->path(), false, 400);
+            resp.MakeResponse(writeBuff_);
+            readBuff_.RetrieveAll();
+        }
+        request_->Init();
+
+        // writeBuff_可能扩容，响应只记录偏移，全部生成后再组装iovec
+        isKeepAlive_ = resp.IsKeepAlive();
+        // 要关闭的连接不再处理后面的请求
+        if(!isKeepAlive_)
+            break;
+        // 流式响应发完之前后面的响应不能开始
+        if(resp.IsStreaming())
+            break;
+    }
+    if(respCnt_ == 0) {
+        ReleaseIdle_();
+        return false;
+    }
+
+    if(IsStreaming_())
+        responses_[respCnt_ - 1]->FillStream(streamBuff_, STREAM_HIGH_WATER);
+    for(int i=0; i<respCnt_; i++) {
+        for(const HttpResponse::FileSlice &slice : responses_[i]->Slices())
+            refs_.push_back({ slice.bufEnd, responses_[i].get(), slice.offset, slice.len });
+    }
+    BuildIov_();
+    LOG_DEBUG("responses:%d, iov:%zu, to write:%zu", respCnt_, iov_.size(), toWrite_);
+    return true;
+}
+
+int HttpConn::IdleTimeoutMs() {
+    if(idleTimeoutMs <= 0)
+        return idleTimeoutMs;
+    const int64_t users = userCount, cap = maxConn;
+    if(users * 4 < cap)
+        return idleTimeoutMs * 2;
+    if(users * 2 < cap)
+        return idleTimeoutMs;
+    if(idleTimeoutMs <= MIN_IDLE_TIMEOUT_MS)
+        return idleTimeoutMs;
+    // 50%到90%之间线性插值
+    const int64_t span = cap * 4;
+    const int64_t over = std::min(users * 10 - cap * 5, span);
+    return idleTimeoutMs - static_cast<int>((idleTimeoutMs - MIN_IDLE_TIMEOUT_MS) * over / span);
+}
+
+// HTTP/2的控制帧和窗口用尽时的尾部DATA帧都很小，不能等Nagle算法攒满或对端的延迟确认
+void HttpConn::StartHttp2_() {
+    h2_.reset(new Http2Session(srcDir));
+    int optval = 1;
+    if(setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)) < 0)
+        LOG_WARN("Client[%d] set TCP_NODELAY error:%d", fd_, errno);
 }
 
-bool HttpConn::process() {
-    // request_.Init();
-    // if(readBuff_.ReadableBytes() <= 0) {
-    //     return false;
-    // }
-    // else if(request_.parse(readBuff_)) {
-    //     LOG_DEBUG("%s", request_.path().c_str());
-    //     response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
-    // } else {
-    //     response_.Init(srcDir, request_.path(), false, 400);
-    // }
-
-    // response_.MakeResponse(writeBuff_);
-    // /* 响应头 */
-    // iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-    // iov_[0].iov_len = writeBuff_.ReadableBytes();
-    // iovCnt_ = 1;
-
-    // /* 文件 */
-    // if(response_.FileLen() > 0  && response_.File()) {
-    //     iov_[1].iov_base = response_.File();
-    //     iov_[1].iov_len = response_.FileLen();
-    //     iovCnt_ = 2;
-    // }
-    // LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen() , iovCnt_, ToWriteBytes());
+// 会话处理所有完整的帧，输出的帧头和内嵌数据在writeBuff_中，文件内容在refs_中
+bool HttpConn::ProcessHttp2_(bool runHandlers) {
+    h2_->Process(readBuff_, writeBuff_, refs_, H2_BATCH_SIZE, runHandlers);
+    isKeepAlive_ = !h2_->IsClosed();
+    if(writeBuff_.ReadableBytes() == 0) {
+        ReleaseIdle_();
+        return false;
+    }
+    BuildIov_();
+    LOG_DEBUG("h2 iov:%zu, to write:%zu", iov_.size(), toWrite_);
     return true;
 }
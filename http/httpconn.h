@@ -2,15 +2,21 @@
 
 #include <sys/types.h>
 #include <sys/uio.h>
+#include <sys/sendfile.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <stdlib.h>
 #include <error.h>
+#include <limits.h>
+#include <vector>
+#include <memory>
 
 #include "../log/log.h"
 #include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
 #include "httpresponse.h"
 #include "httprequest.h"
+#include "../http2/http2session.h"
 
 class HttpConn {
 public:
@@ -24,31 +30,95 @@ public:
     int GetPort() const;
     const char* GetIP() const;
     sockaddr_in GetAddr() const;
-    bool process();
+    // 处理readBuff_中所有完整的请求（流水线），响应按顺序排队，有响应待发送时返回true。
+    // 注册了处理函数的请求可能访问数据库而阻塞，runHandlers为false时（在事件循环线程中）
+    // 处理到这样的请求就停下，HandlerPending()为true，由调用方把process()交给线程池
+    bool process(bool runHandlers = true);
+    bool HandlerPending() const { return handlerPending_ || (h2_ && h2_->HandlerPending()); }
+
+    // 供完成式I/O（io_uring）使用：数据由内核直接交付，发送由调用方提交
+    void AppendRead(const char* data, size_t len);
+    const struct iovec* GetIov() const { return iov_.data() + iovIdx_; }
+    int GetIovCnt() const;                // 从当前位置起连续的内存iovec数，不超过IOV_MAX
+    void Advance(size_t len);             // 已发送len字节，更新iov_
     
-    int ToWriteBytes() {
-        return iov_[0].iov_len + iov_[1].iov_len;
+    size_t ToWriteBytes() const {
+        return toWrite_;
     }
 
+    // 请求解析完后request_会被重置，以最后一个响应的连接方式为准
     bool IsKeepAlive() const {
-        // return request_.IsKeepAlive();
-        return true;
+        return isKeepAlive_;
     }
 
+    static const int MAX_PIPELINE = 128;  // 一批最多合并的响应数
+    // 流式响应的背压：streamBuff_中待发送数据低于低水位时才继续产生，每次补到高水位
+    static const size_t STREAM_HIGH_WATER = 64 * 1024;
+    static const size_t STREAM_LOW_WATER = 16 * 1024;
+    // 一次读入超过此大小的连接改用镜像环形的readBuff_
+    static const size_t MIRROR_READ_BYTES = 256 * 1024;
+    // HTTP/2一批输出的上限，多个流的DATA帧轮转，发完一批再继续，避免一个连接占用过多内存
+    static const size_t H2_BATCH_SIZE = 256 * 1024;
+
+    // 一个连接最多处理的请求数，最后一个响应带Connection: close
+    static const int MAX_KEEPALIVE_REQUESTS = 100;
+    static const int MIN_IDLE_TIMEOUT_MS = 1000;
+
+    // 当前的空闲超时：连接数不到上限的1/4时为idleTimeoutMs的2倍，
+    // 超过一半后随连接数线性缩短，到上限的90%时降为MIN_IDLE_TIMEOUT_MS
+    static int IdleTimeoutMs();
+
     static bool isET;
+    static bool useSendfile;              // 文件内容用sendfile发送，否则映射到内存后writev
     static const char* srcDir;
     static std::atomic<int> userCount;
+    static int idleTimeoutMs;             // 配置的空闲超时，不大于0表示不超时
+    static int maxConn;                   // 连接数上限，取MAX_FD和RLIMIT_NOFILE中较小的
 
 private:
+    // 用sendfile发送的文件段，在iov_中占一个iov_base为nullptr的位置
+    struct FileSeg {
+        HttpResponse* resp;
+        off_t offset;
+    };
+
+    ssize_t SendFile_(int* saveErrno);
+    HttpResponse& NextResponse_();
+    void StartHttp2_();
+    bool ProcessHttp2_(bool runHandlers);
+    void BuildIov_();
+    void ReleaseResponses_();
+    bool IsStreaming_() const;
+    void RefillStream_();
+    void AppendStreamIov_();
+    void ReleaseIdle_();
+
     int fd_;
     struct sockaddr_in addr_;
     bool isClose_;
-    int iovCnt_;
-    struct iovec iov_[2];
+    bool isKeepAlive_;
+    int requestCnt_;                      // 本连接已处理的请求数
+    bool handlerPending_;                 // 停在了要交给处理函数的请求上
+
+    // 一批响应的待发送数据：响应头和multipart分隔头（或HTTP/2的帧头）都在writeBuff_中，
+    // 文件内容按refs_中记录的位置穿插其间，为mmap地址或sendfile文件段
+    std::vector<FileRef> refs_;
+    std::vector<struct iovec> iov_;
+    size_t iovIdx_;                       // 第一个未发送完的iovec
+    std::vector<FileSeg> files_;
+    size_t fileIdx_;                      // 第一个未发送完的文件段
+    size_t toWrite_;
     Buffer readBuff_;
     Buffer writeBuff_;
+    // 流式响应的响应体，排在writeBuff_之后发送；发完的slab直接归还，不用搬动未发送的部分
+    ChainBuffer streamBuff_;
+    size_t streamIov_;                    // iov_中第一个指向streamBuff_的位置
+
+    std::unique_ptr<HttpRequest> request_;  // 收到请求数据时才创建，空闲时释放
+    // 本批的响应对象，连续有请求时跨批次复用，连接空闲时释放；各响应的文件段按在writeBuff_中的偏移记录在响应里
+    std::vector<std::unique_ptr<HttpResponse>> responses_;
+    int respCnt_;
 
-    HttpRequest request_;
-    HttpResponse response_;
+    std::unique_ptr<Http2Session> h2_;    // 升级到HTTP/2后非空，响应对象由会话持有
 
 };
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "httprequest.h"
+
+void HttpRequest::Init() {
+    state_ = REQUEST_LINE;
+    base_ = nullptr;
+    scanned_ = 0;
+    headerLen_ = 0;
+    bodyLen_ = 0;
+    hasContentLen_ = false;
+    method_ = path_ = query_ = version_ = body_ = {0, 0};
+    headerCnt_ = 0;
+}
+
+HttpRequest::PARSE_RESULT HttpRequest::parse(const Buffer &buff) {
+    base_ = buff.Peek();
+    const size_t readable = buff.ReadableBytes();
+    const char* end = base_ + readable;
+
+    while(state_ != FINISH) {
+        if(state_ == BODY) {
+            if(readable < headerLen_ + bodyLen_)
+                return PARSE_AGAIN;
+            body_ = { static_cast<uint32_t>(headerLen_), static_cast<uint32_t>(bodyLen_) };
+            state_ = FINISH;
+            break;
+        }
+
+        // scanned_之前的行都已处理完，从这里继续找行尾（SIMD扫描）
+        const char* lineBegin = base_ + scanned_;
+        const char* lineEnd = Scan::FindByte(lineBegin, end, '\n');
+        if(!lineEnd) {
+            return readable > MAX_HEADER_BYTES ? PARSE_ERROR : PARSE_AGAIN;
+        }
+        scanned_ = lineEnd + 1 - base_;
+        if(scanned_ > MAX_HEADER_BYTES)
+            return PARSE_ERROR;
+
+        // 兼容只有\n的行尾
+        const char* contentEnd = lineEnd;
+        if(contentEnd > lineBegin && *(contentEnd - 1) == '\r')
+            contentEnd--;
+
+        if(state_ == REQUEST_LINE) {
+            if(contentEnd == lineBegin)
+                continue;           // 请求行之前的空行忽略
+            if(!ParseRequestLine_(lineBegin, contentEnd))
+                return PARSE_ERROR;
+            state_ = HEADERS;
+        }
+        else if(contentEnd == lineBegin) {
+            // 空行，请求头结束
+            headerLen_ = scanned_;
+            state_ = bodyLen_ > 0 ? BODY : FINISH;
+        }
+        else if(!ParseHeader_(lineBegin, contentEnd)) {
+            return PARSE_ERROR;
+        }
+    }
+    return PARSE_OK;
+}
+
+// METHOD SP request-target SP HTTP-version
+bool HttpRequest::ParseRequestLine_(const char* begin, const char* end) {
+    const char* sp1 = Scan::FindByte(begin, end, ' ');
+    if(!sp1 || sp1 == begin)
+        return false;
+    for(const char* p = begin; p < sp1; p++) {
+        if(*p < 'A' || *p > 'Z')
+            return false;
+    }
+    const char* target = sp1 + 1;
+    const char* sp2 = Scan::FindByte(target, end, ' ');
+    if(!sp2 || sp2 == target)
+        return false;
+    std::string_view version(sp2 + 1, end - sp2 - 1);
+    if(version != "HTTP/1.1" && version != "HTTP/1.0")
+        return false;
+
+    // absolute-form：去掉scheme和host，只保留路径部分
+    std::string_view uri(target, sp2 - target);
+    if(uri.size() > 7 && uri.compare(0, 7, "http://") == 0) {
+        size_t slash = uri.find('/', 7);
+        if(slash == std::string_view::npos)
+            return false;
+        uri = uri.substr(slash);
+    }
+    if(uri.empty() || uri[0] != '/')
+        return false;
+
+    std::string_view pathView = uri;
+    std::string_view queryView;
+    size_t q = uri.find('?');
+    if(q != std::string_view::npos) {
+        pathView = uri.substr(0, q);
+        queryView = uri.substr(q + 1);
+    }
+    // 拒绝跳出资源目录的路径
+    for(size_t pos = pathView.find("/.."); pos != std::string_view::npos; pos = pathView.find("/..", pos + 1)) {
+        if(pos + 3 == pathView.size() || pathView[pos + 3] == '/')
+            return false;
+    }
+
+    method_ = { static_cast<uint32_t>(begin - base_), static_cast<uint32_t>(sp1 - begin) };
+    path_ = { static_cast<uint32_t>(pathView.data() - base_), static_cast<uint32_t>(pathView.size()) };
+    query_ = { static_cast<uint32_t>((queryView.data() ? queryView.data() : pathView.data()) - base_),
+               static_cast<uint32_t>(queryView.size()) };
+    version_ = { static_cast<uint32_t>(version.data() - base_), static_cast<uint32_t>(version.size()) };
+    return true;
+}
+
+// field-name ":" OWS field-value OWS
+bool HttpRequest::ParseHeader_(const char* begin, const char* end) {
+    if(headerCnt_ >= MAX_HEADERS)
+        return false;
+    // 一次扫描同时找冒号并检查字段名中没有空白
+    const char* colon = Scan::FindAny(begin, end, ": \t", 3);
+    if(!colon || colon == begin || *colon != ':')
+        return false;
+    const char* vb = colon + 1;
+    const char* ve = end;
+    while(vb < ve && (*vb == ' ' || *vb == '\t')) vb++;
+    while(ve > vb && (*(ve - 1) == ' ' || *(ve - 1) == '\t')) ve--;
+
+    Header &h = headers_[headerCnt_++];
+    h.key = { static_cast<uint32_t>(begin - base_), static_cast<uint32_t>(colon - begin) };
+    h.value = { static_cast<uint32_t>(vb - base_), static_cast<uint32_t>(ve - vb) };
+
+    std::string_view key(begin, colon - begin);
+    std::string_view value(vb, ve - vb);
+    if(EqualsIgnoreCase(key, "Content-Length"))
+        return ParseContentLength_(value);
+    // 不支持分块编码的请求体
+    if(EqualsIgnoreCase(key, "Transfer-Encoding"))
+        return false;
+    return true;
+}
+
+bool HttpRequest::ParseContentLength_(std::string_view value) {
+    if(value.empty())
+        return false;
+    size_t len = 0;
+    for(char c : value) {
+        if(c < '0' || c > '9')
+            return false;
+        len = len * 10 + (c - '0');
+        if(len > MAX_BODY_BYTES)
+            return false;
+    }
+    // 重复的Content-Length取值不一致时无法确定消息边界（RFC 9112 6.3）
+    if(hasContentLen_ && len != bodyLen_)
+        return false;
+    hasContentLen_ = true;
+    bodyLen_ = len;
+    return true;
+}
+
+std::string_view HttpRequest::GetHeader(std::string_view key) const {
+    for(int i=0; i<headerCnt_; i++) {
+        if(EqualsIgnoreCase(View_(headers_[i].key), key))
+            return View_(headers_[i].value);
+    }
+    return std::string_view();
+}
+
+// HTTP/1.1默认长连接，除非Connection: close；HTTP/1.0需要显式Connection: keep-alive
+bool HttpRequest::IsKeepAlive() const {
+    std::string_view conn = GetHeader("Connection");
+    bool close = false, keepAlive = false;
+    while(!conn.empty()) {
+        size_t comma = conn.find(',');
+        std::string_view token = conn.substr(0, comma);
+        while(!token.empty() && token.front() == ' ') token.remove_prefix(1);
+        while(!token.empty() && token.back() == ' ') token.remove_suffix(1);
+        if(EqualsIgnoreCase(token, "close")) close = true;
+        else if(EqualsIgnoreCase(token, "keep-alive")) keepAlive = true;
+        if(comma == std::string_view::npos) break;
+        conn.remove_prefix(comma + 1);
+    }
+    if(version() == "HTTP/1.1")
+        return !close;
+    return keepAlive && !close;
+}
+
+// 参数中q值不为0（没有q参数时默认为1）；q=0、q=0.0、q=0.000都表示不接受
+static bool QualityNonZero(std::string_view params) {
+    size_t q = params.find("q=");
+    if(q == std::string_view::npos)
+        q = params.find("Q=");
+    if(q == std::string_view::npos)
+        return true;
+    for(char c : params.substr(q + 2)) {
+        if(c >= '1' && c <= '9')
+            return true;
+        if(c != '0' && c != '.')
+            break;
+    }
+    return false;
+}
+
+// 明确列出的coding优先于*，无论出现在列表的什么位置；coding没有列出时才看*
+bool HttpRequest::AcceptsEncoding(std::string_view coding) const {
+    std::string_view list = GetHeader("Accept-Encoding");
+    bool wildcard = false;
+    while(!list.empty()) {
+        size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        // coding [ OWS ";" OWS "q=" qvalue ]
+        std::string_view name = item.substr(0, item.find(';'));
+        std::string_view params = item.substr(name.size());
+        while(!name.empty() && name.front() == ' ') name.remove_prefix(1);
+        while(!name.empty() && name.back() == ' ') name.remove_suffix(1);
+        if(EqualsIgnoreCase(name, coding))
+            return QualityNonZero(params);
+        if(name == "*")
+            wildcard = QualityNonZero(params);
+    }
+    return wildcard;
+}
+
+bool HttpRequest::EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if(a.size() != b.size())
+        return false;
+    for(size_t i=0; i<a.size(); i++) {
+        char x = a[i], y = b[i];
+        if(x >= 'A' && x <= 'Z') x += 'a' - 'A';
+        if(y >= 'A' && y <= 'Z') y += 'a' - 'A';
+        if(x != y)
+            return false;
+    }
+    return true;
+}
@@ -1,5 +1,97 @@
 # pragma once
 
-class HttpRequest{
-    
-};
\ No newline at end of file
+#include <string_view>
+#include <stdint.h>
+#include <assert.h>
+
+#include "../buffer/buffer.h"
+
+/*
+    增量式HTTP/1.1请求解析器（状态机）：
+    - 直接在readBuff_的可读数据上解析，不拷贝、不分配内存；
+    - 一个请求分多次到达时，记住已扫描的位置和状态，下次从断点继续；
+    - 解析结果以偏移量保存，通过string_view访问，视图指向缓冲区，
+      在下一次修改该缓冲区（Retrieve/Append/ReadFd）之前有效。
+*/
+
+class HttpRequest {
+public:
+    enum PARSE_STATE {
+        REQUEST_LINE,
+        HEADERS,
+        BODY,
+        FINISH,
+    };
+
+    enum PARSE_RESULT {
+        PARSE_AGAIN,        // 数据不完整，等待更多数据
+        PARSE_OK,           // 得到一个完整请求
+        PARSE_ERROR,        // 请求格式错误
+    };
+
+    static const int MAX_HEADERS = 64;
+    static const size_t MAX_HEADER_BYTES = 16 * 1024;
+    static const size_t MAX_BODY_BYTES = 8 * 1024 * 1024;
+
+    HttpRequest() { Init(); }
+    ~HttpRequest() = default;
+
+    void Init();
+
+    // 从buff.Peek()开始解析，不会取走数据；返回PARSE_OK后请求共占Length()字节
+    PARSE_RESULT parse(const Buffer &buff);
+    size_t Length() const { return headerLen_ + bodyLen_; }
+    PARSE_STATE State() const { return state_; }
+
+    std::string_view method() const { return View_(method_); }
+    std::string_view path() const { return View_(path_); }
+    std::string_view query() const { return View_(query_); }
+    std::string_view version() const { return View_(version_); }
+    std::string_view body() const { return View_(body_); }
+
+    // 按名字查找请求头（大小写不敏感），不存在时返回空视图
+    std::string_view GetHeader(std::string_view key) const;
+    int HeaderCount() const { return headerCnt_; }
+    std::string_view HeaderKey(int i) const { return View_(headers_[i].key); }
+    std::string_view HeaderValue(int i) const { return View_(headers_[i].value); }
+
+    bool IsKeepAlive() const;
+
+    // Accept-Encoding中列出了coding（或*）且q值不为0
+    bool AcceptsEncoding(std::string_view coding) const;
+
+    static bool EqualsIgnoreCase(std::string_view a, std::string_view b);
+
+private:
+    struct Span {
+        uint32_t off;
+        uint32_t len;
+    };
+    struct Header {
+        Span key;
+        Span value;
+    };
+
+    std::string_view View_(Span s) const {
+        return std::string_view(base_ + s.off, s.len);
+    }
+
+    bool ParseRequestLine_(const char* begin, const char* end);
+    bool ParseHeader_(const char* begin, const char* end);
+    bool ParseContentLength_(std::string_view value);
+
+    PARSE_STATE state_;
+    const char* base_;          // 当前请求起始位置，即最近一次parse时的buff.Peek()
+    size_t scanned_;            // 已经扫描过的字节数，下次从这里继续找行尾
+    size_t headerLen_;          // 请求行 + 请求头 + 空行的长度
+    size_t bodyLen_;
+    bool hasContentLen_;        // 已经出现过Content-Length
+
+    Span method_;
+    Span path_;
+    Span query_;
+    Span version_;
+    Span body_;
+    Header headers_[MAX_HEADERS];
+    int headerCnt_;
+};
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "httprequest.h"
+#include "../buffer/buffer.h"
+
+static HttpRequest::PARSE_RESULT ParseAll(HttpRequest &req, const std::string &raw) {
+    Buffer buff;
+    buff.Append(raw);
+    return req.parse(buff);
+}
+
+TEST(HttpRequestTest, SimpleGet) {
+    Buffer buff;
+    buff.Append("GET /index.html?a=1 HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n");
+    HttpRequest req;
+    ASSERT_EQ(req.parse(buff), HttpRequest::PARSE_OK);
+    EXPECT_EQ(req.method(), "GET");
+    EXPECT_EQ(req.path(), "/index.html");
+    EXPECT_EQ(req.query(), "a=1");
+    EXPECT_EQ(req.version(), "HTTP/1.1");
+    EXPECT_EQ(req.GetHeader("host"), "x");
+    EXPECT_FALSE(req.IsKeepAlive());
+    EXPECT_EQ(req.Length(), buff.ReadableBytes());
+}
+
+// 每个字节边界都切成两次到达，结果与一次到达相同
+TEST(HttpRequestTest, SplitAtEveryByte) {
+    const std::string raw = "POST /login HTTP/1.1\r\nHost: x\r\nContent-Length: 11\r\n\r\nuser=a&pw=b";
+    for(size_t cut = 0; cut <= raw.size(); cut++) {
+        Buffer buff;
+        HttpRequest req;
+        buff.Append(raw.substr(0, cut));
+        HttpRequest::PARSE_RESULT ret = req.parse(buff);
+        if(cut < raw.size()) {
+            ASSERT_EQ(ret, HttpRequest::PARSE_AGAIN) << "cut=" << cut;
+            buff.Append(raw.substr(cut));
+            ret = req.parse(buff);
+        }
+        ASSERT_EQ(ret, HttpRequest::PARSE_OK) << "cut=" << cut;
+        EXPECT_EQ(req.method(), "POST");
+        EXPECT_EQ(req.path(), "/login");
+        EXPECT_EQ(req.body(), "user=a&pw=b");
+        EXPECT_EQ(req.Length(), raw.size());
+    }
+}
+
+// 逐字节到达
+TEST(HttpRequestTest, OneByteAtATime) {
+    const std::string raw = "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n";
+    Buffer buff;
+    HttpRequest req;
+    for(size_t i = 0; i < raw.size(); i++) {
+        buff.Append(raw.substr(i, 1));
+        HttpRequest::PARSE_RESULT ret = req.parse(buff);
+        ASSERT_EQ(ret, i + 1 < raw.size() ? HttpRequest::PARSE_AGAIN : HttpRequest::PARSE_OK) << "i=" << i;
+    }
+    EXPECT_TRUE(req.IsKeepAlive());
+}
+
+TEST(HttpRequestTest, HeaderCap) {
+    HttpRequest req;
+    // 请求头超过MAX_HEADER_BYTES
+    std::string raw = "GET / HTTP/1.1\r\nX-Pad: " + std::string(HttpRequest::MAX_HEADER_BYTES, 'a') + "\r\n\r\n";
+    EXPECT_EQ(ParseAll(req, raw), HttpRequest::PARSE_ERROR);
+
+    // 一直没有行尾，超过上限后不再等待
+    req.Init();
+    EXPECT_EQ(ParseAll(req, "GET /" + std::string(HttpRequest::MAX_HEADER_BYTES, 'a')), HttpRequest::PARSE_ERROR);
+
+    // 请求头个数超过MAX_HEADERS
+    req.Init();
+    raw = "GET / HTTP/1.1\r\n";
+    for(int i = 0; i <= HttpRequest::MAX_HEADERS; i++)
+        raw += "X-H" + std::to_string(i) + ": v\r\n";
+    raw += "\r\n";
+    EXPECT_EQ(ParseAll(req, raw), HttpRequest::PARSE_ERROR);
+}
+
+TEST(HttpRequestTest, BodyCap) {
+    HttpRequest req;
+    std::string raw = "POST / HTTP/1.1\r\nContent-Length: " + std::to_string(HttpRequest::MAX_BODY_BYTES) + "\r\n\r\n";
+    EXPECT_EQ(ParseAll(req, raw), HttpRequest::PARSE_AGAIN);
+
+    req.Init();
+    raw = "POST / HTTP/1.1\r\nContent-Length: " + std::to_string(HttpRequest::MAX_BODY_BYTES + 1) + "\r\n\r\n";
+    EXPECT_EQ(ParseAll(req, raw), HttpRequest::PARSE_ERROR);
+
+    // 超长数字不会溢出后绕过上限
+    req.Init();
+    EXPECT_EQ(ParseAll(req, "POST / HTTP/1.1\r\nContent-Length: 18446744073709551617\r\n\r\n"),
+              HttpRequest::PARSE_ERROR);
+}
+
+TEST(HttpRequestTest, ContentLength) {
+    const char* bad[] = {
+        "Content-Length: \r\n",
+        "Content-Length: -1\r\n",
+        "Content-Length: +5\r\n",
+        "Content-Length: 5x\r\n",
+        "Content-Length: 0x5\r\n",
+        "Content-Length: 5, 5\r\n",
+        "Content-Length: 5\r\nContent-Length: 6\r\n",
+        "Content-Length: 5\r\ncontent-length: 0\r\n",
+    };
+    for(const char* cl : bad) {
+        HttpRequest req;
+        EXPECT_EQ(ParseAll(req, std::string("POST / HTTP/1.1\r\n") + cl + "\r\nhello"), HttpRequest::PARSE_ERROR) << cl;
+    }
+
+    // 取值相同的重复Content-Length可以接受
+    HttpRequest req;
+    ASSERT_EQ(ParseAll(req, "POST / HTTP/1.1\r\nContent-Length: 5\r\ncontent-length:  5 \r\n\r\nhello"),
+              HttpRequest::PARSE_OK);
+    EXPECT_EQ(req.body(), "hello");
+}
+
+TEST(HttpRequestTest, TransferEncodingRejected) {
+    HttpRequest req;
+    EXPECT_EQ(ParseAll(req, "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n"),
+              HttpRequest::PARSE_ERROR);
+    req.Init();
+    EXPECT_EQ(ParseAll(req, "POST / HTTP/1.1\r\nContent-Length: 5\r\ntransfer-encoding: identity\r\n\r\nhello"),
+              HttpRequest::PARSE_ERROR);
+}
+
+TEST(HttpRequestTest, PathTraversal) {
+    const char* bad[] = { "/..", "/../etc/passwd", "/a/../../b", "/a/..", "/a/..?x=1", "http://h/../x" };
+    for(const char* path : bad) {
+        HttpRequest req;
+        EXPECT_EQ(ParseAll(req, std::string("GET ") + path + " HTTP/1.1\r\n\r\n"), HttpRequest::PARSE_ERROR) << path;
+    }
+    const char* good[] = { "/..a", "/a..b/c", "/a/...", "/?p=/../x" };
+    for(const char* path : good) {
+        HttpRequest req;
+        EXPECT_EQ(ParseAll(req, std::string("GET ") + path + " HTTP/1.1\r\n\r\n"), HttpRequest::PARSE_OK) << path;
+    }
+}
+
+TEST(HttpRequestTest, MalformedRequestLine) {
+    const char* bad[] = {
+        "get / HTTP/1.1\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "GET  HTTP/1.1\r\n\r\n",
+        "GET index.html HTTP/1.1\r\n\r\n",
+        "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: v\r\n\r\n",
+        "GET / HTTP/1.1\r\n: v\r\n\r\n",
+    };
+    for(const char* raw : bad) {
+        HttpRequest req;
+        EXPECT_EQ(ParseAll(req, raw), HttpRequest::PARSE_ERROR) << raw;
+    }
+}
+
+// 一次读到多个流水线请求，逐个解析并取走
+TEST(HttpRequestTest, Pipelined) {
+    std::vector<std::string> reqs = {
+        "GET /a HTTP/1.1\r\nHost: x\r\n\r\n",
+        "POST /b HTTP/1.1\r\nContent-Length: 3\r\n\r\nxyz",
+        "\r\nGET /c HTTP/1.1\r\n\r\n",             // 请求之间多余的空行忽略
+        "HEAD /d HTTP/1.1\r\nContent-Length: 0\r\n\r\n",
+    };
+    const char* paths[] = { "/a", "/b", "/c", "/d" };
+    Buffer buff;
+    for(const std::string &r : reqs)
+        buff.Append(r);
+    buff.Append("GET /e HTT");                      // 最后一个只到了一半
+
+    HttpRequest req;
+    for(size_t i = 0; i < reqs.size(); i++) {
+        ASSERT_EQ(req.parse(buff), HttpRequest::PARSE_OK) << i;
+        EXPECT_EQ(req.path(), paths[i]);
+        EXPECT_EQ(req.Length(), reqs[i].size());
+        if(i == 1) {
+            EXPECT_EQ(req.body(), "xyz");
+        }
+        buff.Retrieve(req.Length());
+        req.Init();
+    }
+    EXPECT_EQ(req.parse(buff), HttpRequest::PARSE_AGAIN);
+    buff.Append("P/1.1\r\n\r\n");
+    ASSERT_EQ(req.parse(buff), HttpRequest::PARSE_OK);
+    EXPECT_EQ(req.path(), "/e");
+}
+
+static bool Accepts(const std::string &acceptEncoding, std::string_view coding) {
+    Buffer buff;
+    buff.Append("GET / HTTP/1.1\r\nAccept-Encoding: " + acceptEncoding + "\r\n\r\n");
+    HttpRequest req;
+    EXPECT_EQ(req.parse(buff), HttpRequest::PARSE_OK);
+    return req.AcceptsEncoding(coding);
+}
+
+TEST(HttpRequestTest, AcceptsEncoding) {
+    EXPECT_TRUE(Accepts("gzip", "gzip"));
+    EXPECT_TRUE(Accepts("deflate, GZIP;q=0.5", "gzip"));
+    EXPECT_FALSE(Accepts("deflate, br", "gzip"));
+    EXPECT_FALSE(Accepts("gzip;q=0", "gzip"));
+    EXPECT_FALSE(Accepts("gzip; q=0.000", "gzip"));
+    EXPECT_TRUE(Accepts("gzip;q=0.001", "gzip"));
+    EXPECT_TRUE(Accepts("*", "gzip"));
+    EXPECT_FALSE(Accepts("*;q=0", "gzip"));
+
+    // 明确列出的coding优先于*，与先后顺序无关
+    EXPECT_FALSE(Accepts("*, gzip;q=0", "gzip"));
+    EXPECT_FALSE(Accepts("gzip;q=0, *", "gzip"));
+    EXPECT_TRUE(Accepts("*;q=0, gzip", "gzip"));
+    EXPECT_TRUE(Accepts("gzip, *;q=0", "gzip"));
+    EXPECT_TRUE(Accepts("br, *", "gzip"));
+
+    HttpRequest req;
+    Buffer buff;
+    buff.Append("GET / HTTP/1.1\r\n\r\n");
+    ASSERT_EQ(req.parse(buff), HttpRequest::PARSE_OK);
+    EXPECT_FALSE(req.AcceptsEncoding("gzip"));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
\ No newline at end of file
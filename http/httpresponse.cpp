@@ -1,79 +1,379 @@
 #include "httpresponse.h"
+#include "router.h"
 
-const std::unordered_map<std::string, std::string> HttpResponse::SUFFIX_TYPE = {
+namespace {
+
+/*
+    后缀->MIME类型表：编译期为所有后缀找一个种子，使哈希值在SLOTS个槽里互不冲突（完美哈希），
+    查找时只算一次哈希、比较一次键，不分配内存。空槽指向哨兵项，其值就是默认类型。
+    后缀按ASCII小写比较，".JPG"与".jpg"相同。
+*/
+struct MimeEntry {
+    std::string_view suffix;
+    std::string_view type;
+};
+
+constexpr std::string_view DEFAULT_MIME = "text/plain";
+
+constexpr MimeEntry SUFFIX_TYPE[] = {
     { ".html",  "text/html" },
+    { ".htm",   "text/html" },
     { ".xml",   "text/xml" },
     { ".xhtml", "application/xhtml+xml" },
     { ".txt",   "text/plain" },
+    { ".md",    "text/markdown" },
+    { ".csv",   "text/csv" },
     { ".rtf",   "application/rtf" },
     { ".pdf",   "application/pdf" },
-    { ".word",  "application/nsword" },
+    { ".word",  "application/msword" },
+    { ".doc",   "application/msword" },
+    { ".json",  "application/json" },
+    { ".map",   "application/json" },
+    { ".wasm",  "application/wasm" },
     { ".png",   "image/png" },
     { ".gif",   "image/gif" },
     { ".jpg",   "image/jpeg" },
     { ".jpeg",  "image/jpeg" },
+    { ".webp",  "image/webp" },
+    { ".avif",  "image/avif" },
+    { ".svg",   "image/svg+xml" },
+    { ".ico",   "image/x-icon" },
+    { ".bmp",   "image/bmp" },
     { ".au",    "audio/basic" },
+    { ".mp3",   "audio/mpeg" },
+    { ".ogg",   "audio/ogg" },
+    { ".wav",   "audio/wav" },
     { ".mpeg",  "video/mpeg" },
     { ".mpg",   "video/mpeg" },
     { ".avi",   "video/x-msvideo" },
+    { ".mp4",   "video/mp4" },
+    { ".webm",  "video/webm" },
+    { ".woff",  "font/woff" },
+    { ".woff2", "font/woff2" },
+    { ".ttf",   "font/ttf" },
+    { ".otf",   "font/otf" },
     { ".gz",    "application/x-gzip" },
     { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
+    { ".zip",   "application/zip" },
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
+    { ".mjs",   "text/javascript" },
+};
+
+constexpr size_t MIME_NUM = sizeof(SUFFIX_TYPE) / sizeof(SUFFIX_TYPE[0]);
+constexpr size_t MIME_SLOTS = 256;          // 2的幂，装载率低时很快能找到无冲突的种子
+
+constexpr char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+constexpr uint32_t HashSuffix(std::string_view s, uint32_t seed) {
+    uint32_t h = seed;
+    for(char c : s)
+        h = (h ^ static_cast<uint8_t>(ToLower(c))) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+struct MimeTable {
+    uint32_t seed = 0;
+    uint8_t slot[MIME_SLOTS] = {};          // 槽->SUFFIX_TYPE下标，MIME_NUM表示空
+};
+
+constexpr MimeTable BuildMimeTable() {
+    MimeTable table;
+    for(uint32_t seed = 2166136261u; ; seed++) {
+        for(size_t i = 0; i < MIME_SLOTS; i++)
+            table.slot[i] = MIME_NUM;
+        bool ok = true;
+        for(size_t i = 0; i < MIME_NUM && ok; i++) {
+            uint32_t idx = HashSuffix(SUFFIX_TYPE[i].suffix, seed) & (MIME_SLOTS - 1);
+            if(table.slot[idx] != MIME_NUM)
+                ok = false;
+            else
+                table.slot[idx] = i;
+        }
+        if(ok) {
+            table.seed = seed;
+            return table;
+        }
+    }
+}
+
+static_assert(MIME_NUM < 255 && MIME_NUM * 2 < MIME_SLOTS, "too many mime types");
+constexpr MimeTable MIME_TABLE = BuildMimeTable();
+
+constexpr bool SuffixEqual(std::string_view suffix, std::string_view key) {
+    if(suffix.size() != key.size())
+        return false;
+    for(size_t i = 0; i < key.size(); i++) {
+        if(ToLower(suffix[i]) != key[i])
+            return false;
+    }
+    return true;
+}
+
+constexpr std::string_view LookupMime(std::string_view suffix) {
+    uint8_t i = MIME_TABLE.slot[HashSuffix(suffix, MIME_TABLE.seed) & (MIME_SLOTS - 1)];
+    if(i == MIME_NUM || !SuffixEqual(suffix, SUFFIX_TYPE[i].suffix))
+        return DEFAULT_MIME;
+    return SUFFIX_TYPE[i].type;
+}
+
+static_assert(LookupMime(".html") == "text/html", "mime table");
+static_assert(LookupMime(".WOFF2") == "font/woff2", "mime table");
+static_assert(LookupMime(".unknown") == DEFAULT_MIME, "mime table");
+
+/*
+    状态码直接作为下标（100~599），状态行整体预先写好，原因短语从中截取；
+    没有错误页的状态errorPage为空
+*/
+struct StatusEntry {
+    std::string_view line;
+    std::string_view errorPage;
 };
 
-const std::unordered_map<int, std::string> HttpResponse::CODE_STATUS = {
-    { 200, "OK" },
-    { 400, "Bad Request" },
-    { 403, "Forbidden" },
-    { 404, "Not Found" },
+constexpr StatusEntry CODE_STATUS[] = {
+    { "HTTP/1.1 200 OK\r\n",                     "" },
+    { "HTTP/1.1 206 Partial Content\r\n",        "" },
+    { "HTTP/1.1 304 Not Modified\r\n",           "" },
+    { "HTTP/1.1 400 Bad Request\r\n",            "/400.html" },
+    { "HTTP/1.1 403 Forbidden\r\n",              "/403.html" },
+    { "HTTP/1.1 404 Not Found\r\n",              "/404.html" },
+    { "HTTP/1.1 416 Range Not Satisfiable\r\n",  "" },
+    { "HTTP/1.1 500 Internal Server Error\r\n",  "" },
+    { "HTTP/1.1 503 Service Unavailable\r\n",    "" },
 };
 
+constexpr int MIN_CODE = 100;
+constexpr int MAX_CODE = 599;
+
+constexpr int ParseCode(std::string_view line) {
+    return (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+}
 
-const std::unordered_map<int, std::string> HttpResponse::CODE_PATH = {
-    { 400, "/400.html" },
-    { 403, "/403.html" },
-    { 404, "/404.html" },
+struct StatusTable {
+    StatusEntry entry[MAX_CODE - MIN_CODE + 1] = {};
 };
 
+constexpr StatusTable BuildStatusTable() {
+    StatusTable table;
+    for(const StatusEntry &status : CODE_STATUS)
+        table.entry[ParseCode(status.line) - MIN_CODE] = status;
+    return table;
+}
+
+constexpr StatusTable STATUS_TABLE = BuildStatusTable();
+
+// 未知状态码返回空的状态行
+constexpr const StatusEntry& LookupStatus(int code) {
+    return STATUS_TABLE.entry[(code < MIN_CODE || code > MAX_CODE) ? 0 : code - MIN_CODE];
+}
+
+static_assert(LookupStatus(404).errorPage == "/404.html", "status table");
+static_assert(LookupStatus(100).line.empty() && LookupStatus(999).line.empty(), "status table");
+
+// "HTTP/1.1 404 Not Found\r\n" -> "Not Found"
+constexpr std::string_view ReasonPhrase(std::string_view line) {
+    return line.substr(13, line.size() - 15);
+}
+
+static_assert(ReasonPhrase(LookupStatus(200).line) == "OK", "status table");
+
+constexpr std::string_view KEEP_ALIVE_HEADER = "Connection: keep-alive\r\n";
+constexpr std::string_view CLOSE_HEADER = "Connection: close\r\n";
+
+/*
+    Date头缓存：Reactor每秒格式化一次写入下一个槽，再发布槽号；
+    工作线程只读取当前槽，读者落后若干秒才可能看到被改写的槽
+*/
+const int DATE_SLOTS = 4;
+const size_t DATE_LEN = sizeof("Date: Thu, 01 Jan 1970 00:00:00 GMT\r\n") - 1;
+char g_dates[DATE_SLOTS][DATE_LEN + 1];
+std::atomic<int> g_dateSlot(0);
+std::atomic<time_t> g_dateSec(-1);
+std::atomic_flag g_dateLock = ATOMIC_FLAG_INIT;
+
+const bool g_dateInit = (HttpResponse::RefreshDate(), true);
+
+} // namespace
+
+void HttpResponse::RefreshDate() {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    if(now.tv_sec == g_dateSec.load(std::memory_order_relaxed))
+        return;
+    // 多个Reactor同时发现秒数变化时只由一个更新
+    if(g_dateLock.test_and_set(std::memory_order_acquire))
+        return;
+    if(now.tv_sec != g_dateSec.load(std::memory_order_relaxed)) {
+        int slot = (g_dateSlot.load(std::memory_order_relaxed) + 1) % DATE_SLOTS;
+        struct tm tm;
+        gmtime_r(&now.tv_sec, &tm);
+        strftime(g_dates[slot], sizeof(g_dates[slot]), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        g_dateSlot.store(slot, std::memory_order_release);
+        g_dateSec.store(now.tv_sec, std::memory_order_relaxed);
+    }
+    g_dateLock.clear(std::memory_order_release);
+}
+
+std::string_view HttpResponse::DateHeader() {
+    return std::string_view(g_dates[g_dateSlot.load(std::memory_order_acquire)], DATE_LEN);
+}
+
+
 HttpResponse::HttpResponse() {
     code_ = -1;
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
+    keepAliveTimeout_ = 0;
+    gzip_ = nullptr;
     mmFile_ = nullptr;
-    mmFileStat_ = {0};
+    ownMap_ = false;
+    chunked_ = false;
+    allowPrebuilt_ = false;
+    isHead_ = false;
 }
 
 HttpResponse::~HttpResponse() {
-    UnmapFile();
+    ReleaseFile();
 }
 
-void HttpResponse::Init(const std::string &srcDir, std::string & path,
+void HttpResponse::Init(const std::string &srcDir, std::string_view path,
                         bool isKeepAlive, int code) {
     assert(srcDir != "");
-    if(mmFile_) 
-        UnmapFile();
+    ReleaseFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
-    path_ = path;
+    keepAliveTimeout_ = 0;
+    allowPrebuilt_ = false;
+    isHead_ = false;
+    // assign复用已有容量，连接上的后续请求不再分配
+    path_.assign(path.data(), path.size());
+    if(path_.empty() || path_.back() == '/')
+        path_ += "index.html";
     srcDir_ = srcDir;
-    mmFile_ = nullptr;
-    mmFileStat_ = {0};
+    ranges_.clear();
+    slices_.clear();
 }
 
-void HttpResponse::MakeResponse(Buffer &buff) {
-    // 判断请求的资源数据
-    if(stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode))
-        code_ = 404;
-    else if(!(mmFileStat_.st_mode & S_IROTH))
-        code_ = 403;
-    else if(code_ == -1)
-        code_ = 200;
+void HttpResponse::SetKeepAlive(int timeoutSec) {
+    keepAliveTimeout_ = timeoutSec;
+}
+
+void HttpResponse::MakeResponse(Buffer &buff, const HttpRequest* request) {
+    // 注册了处理函数的请求交给处理函数，其余按静态文件处理
+    if(request && code_ != 400) {
+        HttpRouter::Handler handler = HttpRouter::Find(request->method(), request->path());
+        if(handler) {
+            handler(*request, *this, buff);
+            return;
+        }
+    }
+    MakeFileResponse_(buff, request);
+}
+
+void HttpResponse::MakeFileResponse(Buffer &buff, std::string_view path, const HttpRequest* request) {
+    path_.assign(path.data(), path.size());
+    code_ = 200;
+    MakeFileResponse_(buff, request);
+}
+
+void HttpResponse::MakeErrorResponse(Buffer &buff, int code, std::string_view msg) {
+    code_ = code;
+    AddHeader_(buff);
+    buff.Append("Content-type: text/html\r\n");
+    ErrorContent(buff, std::string(msg));
+}
+
+void HttpResponse::MakeFileResponse_(Buffer &buff, const HttpRequest* request) {
+    isHead_ = request && request->method() == "HEAD";
+    // 判断请求的资源数据，解析失败的请求直接返回400
+    if(code_ != 400) {
+        file_ = FileCache::Instance()->Get(path_);
+        if(!file_)
+            code_ = 404;
+        else if(!file_->IsReadable())
+            code_ = 403;
+        else if(code_ == -1)
+            code_ = 200;
+    }
+    // 客户端缓存的版本仍然有效时只回一个头部
+    if(code_ == 200 && request && IsNotModified_(*request))
+        code_ = 304;
+    // 只对完整的200响应处理Range，可能变为206或416
+    if(code_ == 200 && request)
+        ParseRange_(*request);
     
     ErrorHtml_();
-    AddStateLine_(buff);
+    if(code_ == 200 && request && allowPrebuilt_ && AddPrebuilt_(buff, *request))
+        return;
     AddHeader_(buff);
-    AddContent_(buff);
+    AddContent_(buff, request);
+}
+
+void HttpResponse::MakeStreamResponse(Buffer &buff, const HttpRequest &request, std::string_view mimeType,
+                                      std::unique_ptr<BodyStream> stream, int code) {
+    assert(stream);
+    code_ = code;
+    chunked_ = request.version() == "HTTP/1.1";
+    // 不知道长度又不能分块时只能靠关闭连接表示结束
+    if(!chunked_)
+        isKeepAlive_ = false;
+    AddHeader_(buff);
+    buff.Append({ "Content-type: ", mimeType, "\r\n",
+                  chunked_ ? "Transfer-Encoding: chunked\r\n\r\n" : "\r\n" });
+    if(request.method() != "HEAD")
+        stream_ = std::move(stream);
+}
+
+/*
+    每块的长度在产生数据之前未知，先占一段定宽的十六进制长度，
+    数据产生后再回填（块长度允许有前导0）；ChainBuffer中已写入的数据地址不变，
+    数据直接写入buff，不经过中间缓冲
+*/
+void HttpResponse::FillStream(ChainBuffer &buff, size_t highWater) {
+    static const size_t SIZE_LEN = 8;
+    while(stream_ && buff.ReadableBytes() < highWater) {
+        size_t maxLen = highWater - buff.ReadableBytes();
+        if(!chunked_) {
+            size_t mark = buff.ReadableBytes();
+            bool more = stream_->Produce(buff, maxLen);
+            if(more && buff.ReadableBytes() == mark)
+                AbortStream_();
+            else if(!more)
+                stream_.reset();
+            continue;
+        }
+        size_t mark = buff.ReadableBytes();
+        char* size = buff.AppendSpace(SIZE_LEN + 2);
+        memcpy(size, "00000000\r\n", SIZE_LEN + 2);
+        bool more = stream_->Produce(buff, maxLen);
+        size_t len = buff.ReadableBytes() - mark - SIZE_LEN - 2;
+        if(len == 0 && more) {
+            buff.Unwrite(SIZE_LEN + 2);
+            AbortStream_();
+            continue;
+        }
+        if(len > 0) {
+            for(size_t i = SIZE_LEN; i > 0; i--, len >>= 4)
+                size[i - 1] = "0123456789abcdef"[len & 0xf];
+            buff.Append("\r\n", 2);
+        }
+        else {
+            buff.Unwrite(SIZE_LEN + 2);
+        }
+        if(!more) {
+            buff.Append("0\r\n\r\n", 5);
+            stream_.reset();
+        }
+    }
+}
+
+// 数据源违反了Produce的约定：不发送结束块，客户端据此知道响应不完整；不再继续调用避免空转
+void HttpResponse::AbortStream_() {
+    LOG_ERROR("body stream of %s produced no data", path_.data());
+    stream_.reset();
+    isKeepAlive_ = false;
 }
 
 char* HttpResponse::File() {
@@ -81,81 +381,372 @@ char* HttpResponse::File() {
 }
 
 size_t HttpResponse::FileLen() const {
-    return mmFileStat_.st_size;
+    if(prebuilt_)
+        return prebuilt_->data.size();
+    if(gzip_)
+        return gzip_->Size();
+    return file_ ? file_->Size() : 0;
+}
+
+int HttpResponse::FileFd() const {
+    if(prebuilt_ || FileLen() == 0)
+        return -1;
+    return gzip_ ? gzip_->Fd() : file_->Fd();
+}
+
+bool HttpResponse::IsFileCached() const {
+    if(prebuilt_)
+        return true;
+    if(FileLen() == 0)
+        return false;
+    return (gzip_ ? gzip_->Data() : file_->Data()) != nullptr;
 }
 
 void HttpResponse::ErrorHtml_() {
-    if(CODE_PATH.count(code_) == 1) {
-        path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_+path_).data(), &mmFileStat_);
+    std::string_view errorPage = LookupStatus(code_).errorPage;
+    if(!errorPage.empty()) {
+        path_.assign(errorPage.data(), errorPage.size());
+        file_ = FileCache::Instance()->Get(path_);
     }
 }
 
-void HttpResponse::AddStateLine_(Buffer &buff) {
-    std::string status;
-    // if(CODE_STATUS.count(code_) == 1) {
-    //     status = CODE_STATUS.find(code_)->second;
-    // }
-    // else {
-    //     code_ = 400;
-    //     status = CODE_STATUS.find(code_)->second;
-    // }
-    if(CODE_STATUS.count(code_) != 1)
+std::string_view HttpResponse::StatusLine_() {
+    if(LookupStatus(code_).line.empty())
         code_ = 400;
-    status = CODE_STATUS.find(code_)->second;
-
-    buff.Append("Http/1.1 "+std::to_string(code_) + " " + status + "\r\n");
+    return LookupStatus(code_).line;
 }
 
+// 状态行、Date、Connection都是预先生成的片段，一次拷贝进缓冲区
 void HttpResponse::AddHeader_(Buffer &buff) {
-    buff.Append("Connection: ");
-    if(isKeepAlive_) {
-        buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
-    }
-    else {
-        buff.Append("close\r\n");
+    std::string_view statusLine = StatusLine_();
+    buff.Append({ statusLine, DateHeader(), isKeepAlive_ ? KEEP_ALIVE_HEADER : CLOSE_HEADER });
+    char hint[64];
+    buff.Append(hint, KeepAliveHint_(hint, sizeof(hint)));
+}
+
+size_t HttpResponse::KeepAliveHint_(char* buf, size_t size) const {
+    if(!isKeepAlive_ || keepAliveTimeout_ <= 0)
+        return 0;
+    return snprintf(buf, size, "Keep-Alive: timeout=%d\r\n", keepAliveTimeout_);
+}
+
+/*
+    小文件的200响应整块取自缓存，作为唯一的文件段与流水线中相邻的响应一起writev，不向buff写入任何数据；
+    Date的秒数或Keep-Alive的超时变了就重新拼一份替换，旧的一份在发送它的响应释放后回收；
+    HEAD请求共用同一份，只发送其中的响应头。Range、304等不走这里
+*/
+bool HttpResponse::AddPrebuilt_(Buffer &buff, const HttpRequest &request) {
+    if(request.method() != "GET" && !isHead_)
+        return false;
+    const EncodedFile* gzip = (file_->IsCompressible() && request.AcceptsEncoding("gzip")) ?
+                              FileCache::Instance()->GetGzip(file_) : nullptr;
+    const char* body = gzip ? gzip->Data() : file_->Data();
+    size_t bodyLen = gzip ? gzip->Size() : file_->Size();
+    if(!body || bodyLen > PREBUILT_MAX_SIZE)
+        return false;
+
+    int variant = (gzip ? 2 : 0) + (isKeepAlive_ ? 1 : 0);
+    int timeout = isKeepAlive_ ? keepAliveTimeout_ : 0;
+    std::string_view date = DateHeader();
+    PrebuiltPtr resp = file_->Prebuilt(variant);
+    if(!resp || resp->keepAliveTimeout != timeout ||
+       resp->data.compare(resp->dateOff, date.size(), date) != 0) {
+        std::string_view statusLine = StatusLine_();
+        const std::string &header = gzip ? gzip->header : file_->Header();
+        std::string_view conn = isKeepAlive_ ? KEEP_ALIVE_HEADER : CLOSE_HEADER;
+        char hint[64];
+        size_t hintLen = KeepAliveHint_(hint, sizeof(hint));
+
+        std::shared_ptr<PrebuiltResponse> built(new PrebuiltResponse());
+        built->data.reserve(statusLine.size() + date.size() + conn.size() + hintLen + header.size() + bodyLen);
+        built->data.append(statusLine).append(date).append(conn).append(hint, hintLen)
+                   .append(header).append(body, bodyLen);
+        built->dateOff = statusLine.size();
+        built->headerLen = built->data.size() - bodyLen;
+        built->keepAliveTimeout = timeout;
+        resp = built;
+        file_->SetPrebuilt(variant, resp);
     }
-    buff.Append("Content-type: "+GetFileType_() + "\r\n");
+    prebuilt_ = std::move(resp);
+    // 这里不经过AddSlice_：HEAD请求也要发送其中的响应头
+    slices_.push_back({ buff.ReadableBytes(), 0, isHead_ ? prebuilt_->headerLen : prebuilt_->data.size() });
+    return true;
 }
 
-void HttpResponse::AddContent_(Buffer &buff) {
-    int srcFd = open((srcDir_+path_).data(), O_RDONLY);
-    if(srcFd < 0) {
+void HttpResponse::AddContent_(Buffer &buff, const HttpRequest* request) {
+    if(!file_) {
+        buff.Append("Content-type: text/html\r\n");
         ErrorContent(buff, "File NotFound!");
         return;
     }
+    LOG_DEBUG("file path %s%s", srcDir_.data(), path_.data());
+    bool acceptGzip = request && file_->IsCompressible() && request->AcceptsEncoding("gzip");
+    if(code_ == 304) {
+        const EncodedFile* gzip = acceptGzip ? FileCache::Instance()->GetGzip(file_) : nullptr;
+        buff.Append({ gzip ? gzip->validators : file_->Validators(), "\r\n" });
+        // 没有响应体，不再持有文件
+        file_.reset();
+        return;
+    }
+    if(code_ == 206) {
+        AddRanges_(buff);
+        return;
+    }
+    if(code_ == 416) {
+        buff.Append("Content-Range: bytes */" + std::to_string(file_->Size()) + "\r\n");
+        buff.Append("Content-type: text/html\r\n");
+        file_.reset();
+        ErrorContent(buff, "Range Not Satisfiable");
+        return;
+    }
+    // 客户端支持gzip且已有压缩变体时发送变体，否则发送原文件（同时安排后台压缩）
+    if(code_ == 200 && acceptGzip)
+        gzip_ = FileCache::Instance()->GetGzip(file_);
+    // Content-type、Content-length在缓存中预先生成
+    buff.Append(gzip_ ? gzip_->header : file_->Header());
+    AddSlice_(buff, 0, FileLen());
+    // HEAD没有响应体，头部生成后不再持有文件
+    if(isHead_) {
+        gzip_ = nullptr;
+        file_.reset();
+    }
+}
 
-    LOG_DEBUG("file path %s", (srcDir_+path_).data());
-    // 将文件映射到内存提高文件的访问速度
-    int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1) {
-        ErrorContent(buff, "File NotFound!");
-        return ;
+// HEAD请求的响应体各段都不发送，响应头中的长度仍按完整响应计算
+void HttpResponse::AddSlice_(Buffer &buff, size_t offset, size_t len) {
+    if(len > 0 && !isHead_)
+        slices_.push_back({ buff.ReadableBytes(), offset, len });
+}
+
+// 范围总是针对原文件，不使用gzip变体；文件内容按偏移直接发送，不复制
+void HttpResponse::AddRanges_(Buffer &buff) {
+    const std::string size = std::to_string(file_->Size());
+    if(ranges_.size() == 1) {
+        size_t start = ranges_[0].first, len = ranges_[0].second;
+        buff.Append("Content-type: " + file_->MimeType() + "\r\n");
+        buff.Append(file_->Validators());
+        buff.Append("Content-Range: bytes " + std::to_string(start) + "-" +
+                    std::to_string(start + len - 1) + "/" + size + "\r\n");
+        buff.Append("Content-length: " + std::to_string(len) + "\r\n\r\n");
+        AddSlice_(buff, start, len);
+        return;
+    }
+
+    // multipart/byteranges：每一部分前是分隔线和部分头，最后是结束分隔线
+    static std::atomic<uint64_t> boundaryCnt(0);
+    char boundary[32];
+    snprintf(boundary, sizeof(boundary), "%016lx", (unsigned long)++boundaryCnt);
+    std::vector<std::string> partHeads;
+    partHeads.reserve(ranges_.size());
+    size_t total = 0;
+    for(const auto &range : ranges_) {
+        partHeads.push_back(std::string("\r\n--") + boundary + "\r\n" +
+                            "Content-type: " + file_->MimeType() + "\r\n" +
+                            "Content-Range: bytes " + std::to_string(range.first) + "-" +
+                            std::to_string(range.first + range.second - 1) + "/" + size + "\r\n\r\n");
+        total += partHeads.back().size() + range.second;
     }
+    std::string tail = std::string("\r\n--") + boundary + "--\r\n";
+    total += tail.size();
 
+    buff.Append(std::string("Content-type: multipart/byteranges; boundary=") + boundary + "\r\n");
+    buff.Append(file_->Validators());
+    buff.Append("Content-length: " + std::to_string(total) + "\r\n\r\n");
+    for(size_t i=0; i<ranges_.size(); i++) {
+        buff.Append(partHeads[i]);
+        AddSlice_(buff, ranges_[i].first, ranges_[i].second);
+    }
+    buff.Append(tail);
+}
+
+bool HttpResponse::MapFile() {
+    if(mmFile_)
+        return true;
+    if(FileLen() == 0)
+        return false;
+    const char* data = prebuilt_ ? prebuilt_->data.data() : gzip_ ? gzip_->Data() : file_->Data();
+    if(data) {
+        mmFile_ = const_cast<char*>(data);
+        ownMap_ = false;
+        return true;
+    }
+    // 大文件不在缓存中映射，按需为本次响应映射
+    void* mmRet = mmap(0, FileLen(), PROT_READ, MAP_PRIVATE, FileFd(), 0);
+    if(mmRet == MAP_FAILED) {
+        LOG_ERROR("mmap %s%s error:%d", srcDir_.data(), path_.data(), errno);
+        return false;
+    }
     mmFile_ = (char*)mmRet;
-    close(srcFd);
-    buff.Append("Content-length: " + std::to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    ownMap_ = true;
+    return true;
 }
 
 void HttpResponse::UnmapFile() {
-    if(mmFile_) {
-        munmap(mmFile_, mmFileStat_.st_size);
-        mmFile_ = nullptr;
+    if(mmFile_ && ownMap_)
+        munmap(mmFile_, FileLen());
+    mmFile_ = nullptr;
+    ownMap_ = false;
+}
+
+void HttpResponse::ReleaseFile() {
+    UnmapFile();
+    gzip_ = nullptr;
+    prebuilt_.reset();
+    file_.reset();
+    stream_.reset();
+}
+
+// If-None-Match优先；没有时再比较If-Modified-Since，只用于GET/HEAD
+bool HttpResponse::IsNotModified_(const HttpRequest &request) const {
+    if(request.method() != "GET" && request.method() != "HEAD")
+        return false;
+
+    std::string_view inm = request.GetHeader("If-None-Match");
+    if(!inm.empty()) {
+        while(!inm.empty()) {
+            size_t comma = inm.find(',');
+            std::string_view tag = inm.substr(0, comma);
+            inm = comma == std::string_view::npos ? std::string_view() : inm.substr(comma + 1);
+            while(!tag.empty() && tag.front() == ' ') tag.remove_prefix(1);
+            while(!tag.empty() && tag.back() == ' ') tag.remove_suffix(1);
+            if(tag == "*" || MatchETag_(tag))
+                return true;
+        }
+        return false;
     }
+
+    std::string_view ims = request.GetHeader("If-Modified-Since");
+    if(ims.empty() || ims.size() >= 64)
+        return false;
+    char date[64];
+    memcpy(date, ims.data(), ims.size());
+    date[ims.size()] = '\0';
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if(!end || *end != '\0')
+        return false;
+    return file_->Stat().st_mtime <= timegm(&tm);
 }
 
-std::string HttpResponse::GetFileType_() {
-    std::string::size_type idx = path_.find_last_of('.');
-    if(idx == std::string::npos)
-        return "text/plain";
-    
-    std::string suffix = path_.substr(idx);
-    if(SUFFIX_TYPE.count(suffix) == 1)
-        return SUFFIX_TYPE.find(suffix)->second;
+// 弱比较：忽略W/前缀；gzip变体的ETag（带-gz）也视为同一版本
+bool HttpResponse::MatchETag_(std::string_view tag) const {
+    if(tag.size() > 2 && tag.compare(0, 2, "W/") == 0)
+        tag.remove_prefix(2);
+    const std::string &etag = file_->ETag();
+    if(tag == etag)
+        return true;
+    return tag.size() == etag.size() + 3 &&
+           tag.compare(tag.size() - 4, 4, "-gz\"") == 0 &&
+           tag.compare(0, etag.size() - 1, etag, 0, etag.size() - 1) == 0;
+}
 
-    return "text/plain";
+// 解析十进制数，只接受数字，溢出时返回false
+static bool ParseOffset(std::string_view s, size_t &val) {
+    if(s.empty() || s.size() > 18)
+        return false;
+    val = 0;
+    for(char c : s) {
+        if(c < '0' || c > '9')
+            return false;
+        val = val * 10 + (c - '0');
+    }
+    return true;
+}
+
+/*
+    解析"Range: bytes=a-b, c-, -n"，结果保存在ranges_中：
+    - 有可满足的范围时改为206，全部不可满足时改为416；
+    - 格式错误、单位不是bytes、范围过多或If-Range不匹配时忽略Range，照常返回整个文件
+    返回是否改变了状态码
+*/
+bool HttpResponse::ParseRange_(const HttpRequest &request) {
+    if(request.method() != "GET")
+        return false;
+    std::string_view range = request.GetHeader("Range");
+    if(range.size() < 6 || strncasecmp(range.data(), "bytes=", 6) != 0)
+        return false;
+    std::string_view ifRange = request.GetHeader("If-Range");
+    if(!ifRange.empty() && !IfRangeMatch_(ifRange))
+        return false;
+    range.remove_prefix(6);
+
+    const size_t size = file_->Size();
+    bool valid = false;
+    ranges_.clear();
+    while(!range.empty()) {
+        size_t comma = range.find(',');
+        std::string_view spec = range.substr(0, comma);
+        range = comma == std::string_view::npos ? std::string_view() : range.substr(comma + 1);
+        while(!spec.empty() && (spec.front() == ' ' || spec.front() == '\t')) spec.remove_prefix(1);
+        while(!spec.empty() && (spec.back() == ' ' || spec.back() == '\t')) spec.remove_suffix(1);
+        if(spec.empty())
+            continue;
+
+        size_t dash = spec.find('-');
+        if(dash == std::string_view::npos) {
+            ranges_.clear();
+            return false;
+        }
+        std::string_view first = spec.substr(0, dash), last = spec.substr(dash + 1);
+        size_t start, end;
+        if(first.empty()) {
+            // 后缀范围：最后n个字节
+            size_t n;
+            if(!ParseOffset(last, n)) {
+                ranges_.clear();
+                return false;
+            }
+            valid = true;
+            if(n == 0 || size == 0)
+                continue;
+            start = n < size ? size - n : 0;
+            end = size - 1;
+        }
+        else {
+            if(!ParseOffset(first, start) || (!last.empty() && !ParseOffset(last, end)) ||
+               (!last.empty() && end < start)) {
+                ranges_.clear();
+                return false;
+            }
+            valid = true;
+            if(start >= size)
+                continue;
+            if(last.empty() || end >= size)
+                end = size - 1;
+        }
+        ranges_.emplace_back(start, end - start + 1);
+        if(ranges_.size() > MAX_RANGES) {
+            ranges_.clear();
+            return false;
+        }
+    }
+    if(!valid)
+        return false;
+    code_ = ranges_.empty() ? 416 : 206;
+    return true;
+}
+
+// If-Range为强ETag或Last-Modified日期，与当前版本完全一致时Range才有效
+bool HttpResponse::IfRangeMatch_(std::string_view ifRange) const {
+    if(ifRange.front() == '"')
+        return ifRange == file_->ETag();
+    if(ifRange.size() > 2 && ifRange.compare(0, 2, "W/") == 0)
+        return false;
+    std::string_view validators = file_->Validators();
+    size_t pos = validators.find("Last-Modified: ");
+    if(pos == std::string_view::npos)
+        return false;
+    pos += 15;
+    return validators.compare(pos, ifRange.size(), ifRange) == 0 &&
+           validators.compare(pos + ifRange.size(), 2, "\r\n") == 0;
+}
+
+std::string_view HttpResponse::GetMimeType(std::string_view path) {
+    std::string_view::size_type idx = path.find_last_of("./");
+    if(idx == std::string_view::npos || path[idx] != '.')
+        return DEFAULT_MIME;
+    return LookupMime(path.substr(idx));
 }
 
 void HttpResponse::ErrorContent(Buffer &buff, std::string msg) {
@@ -163,15 +754,14 @@ void HttpResponse::ErrorContent(Buffer &buff, std::string msg) {
     std::string status;
     body += "<html><title>ERROR</title>";
     body += "<body bgcolor=\"ffffff\">";
-    if(CODE_STATUS.count(code_) == 1)
-        status = CODE_STATUS.find(code_)->second;
-    else 
-        status = "Bad Request";
-    
+    std::string_view line = LookupStatus(code_).line;
+    status = line.empty() ? "Bad Request" : ReasonPhrase(line);
+
     body += std::to_string(code_) + " : " + status + "\n";
     body += "<p>" + msg + "</p>";
     body += "<hr><em>TinyWebServer</em></body></html>";
 
-    buff.Append("Ccontent-length: " + std::to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
+    buff.Append("Content-length: " + std::to_string(body.size()) + "\r\n\r\n");
+    if(!isHead_)
+        buff.Append(body);
 }
\ No newline at end of file
@@ -1,43 +1,124 @@
 # pragma once
 
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <time.h>
+#include <atomic>
+#include <memory>
 
 #include "../log/log.h"
 #include "../buffer/buffer.h"
+#include "../buffer/chainbuffer.h"
+#include "filecache.h"
+#include "httprequest.h"
+
+// 增量产生的响应体，例如动态生成的页面或逐行读取的查询结果
+class BodyStream {
+public:
+    virtual ~BodyStream() = default;
+    // 向buff追加1到maxLen字节的数据（maxLen总大于0），返回false表示数据已全部产生，
+    // 此时可以不追加。返回true却没有追加数据视为数据源出错：响应在此中断并关闭连接
+    virtual bool Produce(ChainBuffer &buff, size_t maxLen) = 0;
+};
 
 class HttpResponse {
 public:
+    // 响应体中的一段文件内容，紧跟在缓冲区前bufEnd字节之后发送；
+    // 整个文件、单个范围或multipart的每一部分各是一段，分隔头留在缓冲区中
+    struct FileSlice {
+        size_t bufEnd;
+        size_t offset;
+        size_t len;
+    };
+
     HttpResponse();
     ~HttpResponse();
 
-    void Init(const std::string &srcDir, std::string &path,
+    void Init(const std::string &srcDir, std::string_view path,
                 bool isKeepAlive = false, int code = -1);
-    void MakeResponse(Buffer &buff);
+    // 保持连接时在Keep-Alive头中告知客户端空闲超时（秒），Init之后调用
+    void SetKeepAlive(int timeoutSec);
+    // 允许直接发送缓存中拼好的小文件响应（只适用于HTTP/1.1连接），Init之后调用
+    void EnablePrebuilt() { allowPrebuilt_ = true; }
+    // request为nullptr表示请求无法解析；需在请求数据从缓冲区取走之前调用。
+    // 路由中注册了的请求交给对应的处理函数，其余返回Init时给出的路径下的文件
+    void MakeResponse(Buffer &buff, const HttpRequest* request = nullptr);
+    // 供处理函数使用：返回资源目录下path处的文件（处理方式与静态文件相同），或只带错误页的响应
+    void MakeFileResponse(Buffer &buff, std::string_view path, const HttpRequest* request = nullptr);
+    void MakeErrorResponse(Buffer &buff, int code, std::string_view msg);
+    // 流式响应：不预先计算长度，响应体由FillStream分批产生，HTTP/1.1用chunked编码，
+    // HTTP/1.0直接发送并在结束后关闭连接
+    void MakeStreamResponse(Buffer &buff, const HttpRequest &request, std::string_view mimeType,
+                            std::unique_ptr<BodyStream> stream, int code = 200);
+    // 响应头写入MakeStreamResponse的buff，响应体写入单独的ChainBuffer：
+    // 产生数据直到buff中可读字节数达到highWater或数据结束，结束后IsStreaming()为false；
+    // 数据源出错时响应体不完整，IsKeepAlive()变为false，发送完已有数据后应关闭连接
+    void FillStream(ChainBuffer &buff, size_t highWater);
+    bool IsStreaming() const { return stream_ != nullptr; }
+
+    // 响应体文件来自FileCache，可直接用FileFd() sendfile；需要内存地址时再调用MapFile()
+    int FileFd() const;
+    bool IsFileCached() const;  // 文件内容已由缓存映射，MapFile()不需要系统调用
+    bool MapFile();
     void UnmapFile();
+    void ReleaseFile();        // 解除映射并放开对缓存文件和数据源的引用
     char* File();
     size_t FileLen() const;
+    const std::vector<FileSlice>& Slices() const { return slices_; }
     void ErrorContent(Buffer &buff, std::string msg);
     int Code() { return code_; }
+    bool IsKeepAlive() const { return isKeepAlive_; }
+
+    static std::string_view GetMimeType(std::string_view path);
+    // 由Reactor在每轮事件循环后调用，秒数变化时才重新格式化Date头
+    static void RefreshDate();
+    static std::string_view DateHeader();
 
 private:
-    void AddStateLine_(Buffer &buff);
+    void MakeFileResponse_(Buffer &buff, const HttpRequest* request);
+    std::string_view StatusLine_();
     void AddHeader_(Buffer &buff);
-    void AddContent_(Buffer &buff);
+    size_t KeepAliveHint_(char* buf, size_t size) const;
+    bool AddPrebuilt_(Buffer &buff, const HttpRequest &request);
+    void AbortStream_();
+    void AddContent_(Buffer &buff, const HttpRequest* request);
     void ErrorHtml_();
-    std::string GetFileType_();
+    bool IsNotModified_(const HttpRequest &request) const;
+    bool MatchETag_(std::string_view tag) const;
+    bool ParseRange_(const HttpRequest &request);
+    bool IfRangeMatch_(std::string_view ifRange) const;
+    void AddRanges_(Buffer &buff);
+    void AddSlice_(Buffer &buff, size_t offset, size_t len);
 
     int code_;
     bool isKeepAlive_;
+    int keepAliveTimeout_;     // 为0时不发送Keep-Alive头
     std::string path_;
     std::string srcDir_;
-    char* mmFile_;             // 内存映射文件
-    struct stat mmFileStat_;   // 存储文件的元数据，例如文件大小、权限、修改时间等
+    FilePtr file_;             // 响应体文件，连同元数据和预生成的头部由缓存共享
+    const EncodedFile* gzip_;  // 发送gzip变体时非空，由file_持有
+    char* mmFile_;             // 内存映射文件，小文件直接使用缓存中的映射
+    bool ownMap_;              // mmFile_是否由本对象映射
+    std::vector<std::pair<size_t, size_t>> ranges_;     // 206响应的范围（起点，长度）
+    std::vector<FileSlice> slices_;
+    std::unique_ptr<BodyStream> stream_;
+    bool chunked_;
+    bool allowPrebuilt_;
+    bool isHead_;              // HEAD请求：响应头照常生成（包括Content-length），不发送响应体
+    PrebuiltPtr prebuilt_;     // 非空时整个响应就是这一块，作为唯一的文件段发送
+
+    static const size_t MAX_RANGES = 16;    // 超过时忽略Range，防止大量小范围放大开销
+    static const size_t PREBUILT_MAX_SIZE = 16 * 1024;  // 响应体不超过此大小才预先拼好
+};
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
-    static const std::unordered_map<int, std::string> CODE_STATUS;
-    static const std::unordered_map<int, std::string> CODE_PATH;
-};
\ No newline at end of file
+// 待发送数据中的一段文件内容：紧跟在输出缓冲区前bufEnd字节之后，由HttpConn组装成iovec或sendfile段
+struct FileRef {
+    size_t bufEnd;
+    HttpResponse* resp;
+    size_t offset;
+    size_t len;
+};
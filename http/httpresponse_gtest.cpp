@@ -0,0 +1,336 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "httpresponse.h"
+#include "../buffer/buffer.h"
+
+class HttpResponseTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/httpresponse_gtestXXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+        // 26个字节，取任意一段都能直接看出位置
+        content_ = "abcdefghijklmnopqrstuvwxyz";
+        FILE* fp = fopen((dir_ + "/file.txt").c_str(), "w");
+        ASSERT_NE(fp, nullptr);
+        fwrite(content_.data(), 1, content_.size(), fp);
+        fclose(fp);
+        FileCache::Instance()->Init(dir_.c_str());
+        HttpResponse::RefreshDate();
+    }
+
+    void TearDown() override {
+        FileCache::Instance()->Close();
+        unlink((dir_ + "/file.txt").c_str());
+        rmdir(dir_.c_str());
+    }
+
+    // 生成对GET /file.txt（附带headers）的响应，按Slices()把缓冲区与文件段拼成实际发出的字节
+    std::string Respond(const std::string &headers, int* code = nullptr) {
+        Buffer in;
+        in.Append("GET /file.txt HTTP/1.1\r\n" + headers + "\r\n");
+        HttpRequest request;
+        EXPECT_EQ(request.parse(in), HttpRequest::PARSE_OK);
+
+        HttpResponse resp;
+        Buffer out;
+        resp.Init(dir_, request.path(), true, 200);
+        resp.MakeResponse(out, &request);
+        if(code)
+            *code = resp.Code();
+        std::string wire;
+        size_t pos = 0;
+        for(const HttpResponse::FileSlice &slice : resp.Slices()) {
+            EXPECT_TRUE(resp.MapFile());
+            wire.append(out.Peek() + pos, slice.bufEnd - pos);
+            wire.append(resp.File() + slice.offset, slice.len);
+            pos = slice.bufEnd;
+        }
+        wire.append(out.Peek() + pos, out.ReadableBytes() - pos);
+        return wire;
+    }
+
+    static std::string Header(const std::string &wire, const std::string &name) {
+        size_t pos = wire.find("\r\n" + name + ": ");
+        if(pos == std::string::npos)
+            return "";
+        pos += name.size() + 4;
+        return wire.substr(pos, wire.find("\r\n", pos) - pos);
+    }
+
+    static std::string Body(const std::string &wire) {
+        size_t pos = wire.find("\r\n\r\n");
+        return pos == std::string::npos ? "" : wire.substr(pos + 4);
+    }
+
+    std::string dir_;
+    std::string content_;
+};
+
+TEST_F(HttpResponseTest, SingleRange) {
+    int code;
+    std::string wire = Respond("Range: bytes=2-5\r\n", &code);
+    EXPECT_EQ(code, 206);
+    EXPECT_EQ(Header(wire, "Content-Range"), "bytes 2-5/26");
+    EXPECT_EQ(Header(wire, "Content-length"), "4");
+    EXPECT_EQ(Body(wire), "cdef");
+
+    // 终点超出文件时截到最后一个字节，开放终点同样
+    wire = Respond("Range: bytes=20-100\r\n", &code);
+    EXPECT_EQ(code, 206);
+    EXPECT_EQ(Header(wire, "Content-Range"), "bytes 20-25/26");
+    EXPECT_EQ(Body(wire), "uvwxyz");
+    EXPECT_EQ(Body(Respond("Range: bytes=23-\r\n")), "xyz");
+}
+
+TEST_F(HttpResponseTest, SuffixRange) {
+    int code;
+    std::string wire = Respond("Range: bytes=-3\r\n", &code);
+    EXPECT_EQ(code, 206);
+    EXPECT_EQ(Header(wire, "Content-Range"), "bytes 23-25/26");
+    EXPECT_EQ(Body(wire), "xyz");
+
+    // 后缀长于文件时就是整个文件
+    wire = Respond("Range: bytes=-100\r\n", &code);
+    EXPECT_EQ(code, 206);
+    EXPECT_EQ(Header(wire, "Content-Range"), "bytes 0-25/26");
+    EXPECT_EQ(Body(wire), content_);
+
+    // -0不选中任何字节，不可满足
+    wire = Respond("Range: bytes=-0\r\n", &code);
+    EXPECT_EQ(code, 416);
+    EXPECT_EQ(Header(wire, "Content-Range"), "bytes */26");
+}
+
+TEST_F(HttpResponseTest, Unsatisfiable) {
+    int code;
+    std::string wire = Respond("Range: bytes=26-\r\n", &code);
+    EXPECT_EQ(code, 416);
+    EXPECT_EQ(Header(wire, "Content-Range"), "bytes */26");
+    EXPECT_EQ(Header(wire, "Content-length"), std::to_string(Body(wire).size()));
+
+    Respond("Range: bytes=100-200, -0\r\n", &code);
+    EXPECT_EQ(code, 416);
+
+    // 只要有一个范围可满足就是206，不可满足的范围跳过
+    wire = Respond("Range: bytes=100-200, 0-0\r\n", &code);
+    EXPECT_EQ(code, 206);
+    EXPECT_EQ(Body(wire), "a");
+}
+
+// 格式错误时忽略整个Range头，返回完整的200响应
+TEST_F(HttpResponseTest, InvalidRangeIgnored) {
+    const char* ranges[] = {
+        "Range: bytes=5-2\r\n",          // 终点小于起点
+        "Range: bytes=0-1, 5-2\r\n",
+        "Range: bytes=abc\r\n",
+        "Range: bytes=1-x\r\n",
+        "Range: items=0-1\r\n",
+        "Range: bytes=,\r\n",
+    };
+    for(const char* range : ranges) {
+        int code;
+        std::string wire = Respond(range, &code);
+        EXPECT_EQ(code, 200) << range;
+        EXPECT_EQ(Header(wire, "Content-Range"), "") << range;
+        EXPECT_EQ(Body(wire), content_) << range;
+    }
+}
+
+TEST_F(HttpResponseTest, TooManyRanges) {
+    // MAX_RANGES为16
+    std::string ranges = "Range: bytes=0-0";
+    for(int i = 1; i < 16; i++)
+        ranges += ", " + std::to_string(i) + "-" + std::to_string(i);
+    int code;
+    Respond(ranges + "\r\n", &code);
+    EXPECT_EQ(code, 206);
+
+    ranges += ", 16-16";
+    std::string wire = Respond(ranges + "\r\n", &code);
+    EXPECT_EQ(code, 200);
+    EXPECT_EQ(Body(wire), content_);
+}
+
+TEST_F(HttpResponseTest, IfRange) {
+    int code;
+    std::string wire = Respond("", &code);
+    ASSERT_EQ(code, 200);
+    std::string etag = Header(wire, "ETag");
+    std::string lastModified = Header(wire, "Last-Modified");
+    ASSERT_FALSE(etag.empty());
+    ASSERT_FALSE(lastModified.empty());
+
+    Respond("Range: bytes=0-1\r\nIf-Range: " + etag + "\r\n", &code);
+    EXPECT_EQ(code, 206);
+    Respond("Range: bytes=0-1\r\nIf-Range: " + lastModified + "\r\n", &code);
+    EXPECT_EQ(code, 206);
+
+    // 不匹配或是弱ETag时忽略Range，发送整个文件
+    const std::string mismatched[] = {
+        "\"0-0\"",
+        "W/" + etag,
+        "Thu, 01 Jan 1970 00:00:00 GMT",
+    };
+    for(const std::string &ifRange : mismatched) {
+        wire = Respond("Range: bytes=0-1\r\nIf-Range: " + ifRange + "\r\n", &code);
+        EXPECT_EQ(code, 200) << ifRange;
+        EXPECT_EQ(Body(wire), content_) << ifRange;
+    }
+}
+
+TEST_F(HttpResponseTest, Multipart) {
+    int code;
+    std::string wire = Respond("Range: bytes=0-2, -2, 10-11\r\n", &code);
+    ASSERT_EQ(code, 206);
+    std::string type = Header(wire, "Content-type");
+    const std::string prefix = "multipart/byteranges; boundary=";
+    ASSERT_EQ(type.compare(0, prefix.size(), prefix), 0);
+    std::string boundary = type.substr(prefix.size());
+
+    std::string expect;
+    const char* parts[][2] = { { "0-2", "abc" }, { "24-25", "yz" }, { "10-11", "kl" } };
+    for(const auto &part : parts) {
+        expect += "\r\n--" + boundary + "\r\n"
+                  "Content-type: text/plain\r\n"
+                  "Content-Range: bytes " + std::string(part[0]) + "/26\r\n\r\n" + part[1];
+    }
+    expect += "\r\n--" + boundary + "--\r\n";
+    std::string body = Body(wire);
+    EXPECT_EQ(body, expect);
+    // Content-length必须与实际发出的字节数完全一致
+    EXPECT_EQ(Header(wire, "Content-length"), std::to_string(body.size()));
+}
+
+// 依次产生pieces中的数据，每次不超过maxLen；emptyEnd时数据产生完后再用一次不写数据的调用结束，
+// broken时数据产生完后返回true却不写数据（违反约定）
+class FakeStream : public BodyStream {
+public:
+    FakeStream(std::vector<std::string> pieces, bool emptyEnd = false, bool broken = false)
+        : pieces_(std::move(pieces)), emptyEnd_(emptyEnd), broken_(broken), maxSeen_(0) {}
+
+    bool Produce(ChainBuffer &buff, size_t maxLen) override {
+        maxSeen_ = std::max(maxSeen_, maxLen);
+        if(pieces_.empty())
+            return broken_;
+        std::string &piece = pieces_.front();
+        size_t len = std::min(maxLen, piece.size());
+        buff.Append(piece.data(), len);
+        piece.erase(0, len);
+        if(piece.empty())
+            pieces_.erase(pieces_.begin());
+        return !pieces_.empty() || emptyEnd_ || broken_;
+    }
+
+    std::vector<std::string> pieces_;
+    bool emptyEnd_;
+    bool broken_;
+    size_t maxSeen_;
+};
+
+class StreamTest : public HttpResponseTest {
+protected:
+    // 对request行发起流式响应，反复FillStream并取走数据直到结束，返回响应头和响应体
+    void Stream(const std::string &requestLine, FakeStream* stream, size_t highWater,
+                std::string &header, std::string &body) {
+        Buffer in;
+        in.Append(requestLine + "\r\n\r\n");
+        HttpRequest request;
+        ASSERT_EQ(request.parse(in), HttpRequest::PARSE_OK);
+
+        Buffer out;
+        resp_.Init(dir_, request.path(), true, 200);
+        resp_.MakeStreamResponse(out, request, "text/plain", std::unique_ptr<BodyStream>(stream));
+        header = out.RetrieveAllToStr();
+        ChainBuffer buff;
+        body.clear();
+        for(int i = 0; resp_.IsStreaming() && i < 100; i++) {
+            resp_.FillStream(buff, highWater);
+            body += buff.RetrieveAllToStr();
+        }
+        EXPECT_FALSE(resp_.IsStreaming());
+    }
+
+    HttpResponse resp_;
+};
+
+TEST_F(StreamTest, Chunked) {
+    FakeStream* stream = new FakeStream({ "hello", "0123456789abcdefghij" }, true);
+    std::string header, body;
+    Stream("GET /stream HTTP/1.1", stream, 16, header, body);
+    EXPECT_EQ(header.substr(0, header.find("\r\n")), "HTTP/1.1 200 OK");
+    EXPECT_EQ(Header(header, "Transfer-Encoding"), "chunked");
+    EXPECT_EQ(Header(header, "Content-length"), "");
+    EXPECT_EQ(header.substr(header.size() - 4), "\r\n\r\n");
+    // 块长度是回填的8位十六进制数；最后一次调用没有数据，占位的块头被撤销，只剩结束块
+    EXPECT_EQ(body, "00000005\r\nhello\r\n"
+                    "00000010\r\n0123456789abcdef\r\n"
+                    "00000004\r\nghij\r\n"
+                    "0\r\n\r\n");
+    EXPECT_EQ(stream->maxSeen_, 16u);
+    EXPECT_TRUE(resp_.IsKeepAlive());
+}
+
+TEST_F(StreamTest, ChunkedLastPieceWithData) {
+    std::string header, body;
+    Stream("GET /stream HTTP/1.1", new FakeStream({ "abc" }), 1024, header, body);
+    EXPECT_EQ(body, "00000003\r\nabc\r\n0\r\n\r\n");
+
+    // 一开始就没有数据：只有结束块
+    Stream("GET /stream HTTP/1.1", new FakeStream({}), 1024, header, body);
+    EXPECT_EQ(body, "0\r\n\r\n");
+}
+
+// HTTP/1.0不能分块，直接发送数据，靠关闭连接表示结束
+TEST_F(StreamTest, Http10CloseDelimited) {
+    std::string header, body;
+    Stream("GET /stream HTTP/1.0", new FakeStream({ "hello", "0123456789abcdefghij" }, true),
+           16, header, body);
+    EXPECT_EQ(Header(header, "Transfer-Encoding"), "");
+    EXPECT_EQ(Header(header, "Connection"), "close");
+    EXPECT_EQ(body, "hello0123456789abcdefghij");
+    EXPECT_FALSE(resp_.IsKeepAlive());
+}
+
+TEST_F(StreamTest, Head) {
+    FakeStream* stream = new FakeStream({ "hello" });
+    Buffer in;
+    in.Append("HEAD /stream HTTP/1.1\r\n\r\n");
+    HttpRequest request;
+    ASSERT_EQ(request.parse(in), HttpRequest::PARSE_OK);
+    Buffer out;
+    resp_.Init(dir_, request.path(), true, 200);
+    resp_.MakeStreamResponse(out, request, "text/plain", std::unique_ptr<BodyStream>(stream));
+    std::string header = out.RetrieveAllToStr();
+    EXPECT_EQ(Header(header, "Transfer-Encoding"), "chunked");
+    EXPECT_EQ(header.substr(header.size() - 4), "\r\n\r\n");
+    // 不产生响应体，stream随即释放
+    EXPECT_FALSE(resp_.IsStreaming());
+    ChainBuffer buff;
+    resp_.FillStream(buff, 16);
+    EXPECT_EQ(buff.ReadableBytes(), 0u);
+}
+
+// 返回true却不写数据时中断响应：不发送结束块，连接不再保持，也不会一直循环调用
+TEST_F(StreamTest, ProduceWithoutData) {
+    std::string header, body;
+    FakeStream* stream = new FakeStream({ "abc" }, false, true);
+    Stream("GET /stream HTTP/1.1", stream, 1024, header, body);
+    EXPECT_EQ(body, "00000003\r\nabc\r\n");
+    EXPECT_FALSE(resp_.IsKeepAlive());
+
+    stream = new FakeStream({ "abc" }, false, true);
+    Stream("GET /stream HTTP/1.0", stream, 1024, header, body);
+    EXPECT_EQ(body, "abc");
+    EXPECT_FALSE(resp_.IsKeepAlive());
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+#include "router.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "userhandler.h"
+
+namespace {
+
+struct Route {
+    std::string_view method;
+    std::string_view path;
+    HttpRouter::Handler handler;
+};
+
+// 新接口在这里加一行，重复的（方法，路径）编译不通过
+constexpr Route ROUTES[] = {
+    { "POST", "/login",     &UserHandler::Login },
+    { "POST", "/register",  &UserHandler::Register },
+};
+
+constexpr size_t ROUTE_NUM = sizeof(ROUTES) / sizeof(ROUTES[0]);
+
+constexpr size_t SlotCount(size_t n) {
+    size_t slots = 16;
+    while(slots < n * 2)
+        slots <<= 1;
+    return slots;
+}
+
+constexpr size_t ROUTE_SLOTS = SlotCount(ROUTE_NUM);   // 2的幂，装载率不超过1/2
+
+constexpr uint32_t HashRoute(std::string_view method, std::string_view path) {
+    uint32_t h = 2166136261u;
+    for(char c : method)
+        h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    h = (h ^ ' ') * 16777619u;
+    for(char c : path)
+        h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    return h ^ (h >> 15);
+}
+
+struct RouteTable {
+    bool unique = true;
+    uint16_t slot[ROUTE_SLOTS] = {};        // 槽->ROUTES下标+1，0表示空
+};
+
+// 线性探测：冲突时放到下一个空槽，查找时遇到空槽即可停止
+constexpr RouteTable BuildRouteTable() {
+    RouteTable table;
+    for(size_t i = 0; i < ROUTE_NUM; i++) {
+        size_t idx = HashRoute(ROUTES[i].method, ROUTES[i].path) & (ROUTE_SLOTS - 1);
+        while(table.slot[idx] != 0) {
+            const Route &other = ROUTES[table.slot[idx] - 1];
+            if(other.method == ROUTES[i].method && other.path == ROUTES[i].path)
+                table.unique = false;
+            idx = (idx + 1) & (ROUTE_SLOTS - 1);
+        }
+        table.slot[idx] = i + 1;
+    }
+    return table;
+}
+
+static_assert(ROUTE_NUM < UINT16_MAX, "too many routes");
+constexpr RouteTable ROUTE_TABLE = BuildRouteTable();
+static_assert(ROUTE_TABLE.unique, "duplicate route");
+
+constexpr HttpRouter::Handler LookupRoute(std::string_view method, std::string_view path) {
+    size_t idx = HashRoute(method, path) & (ROUTE_SLOTS - 1);
+    while(ROUTE_TABLE.slot[idx] != 0) {
+        const Route &route = ROUTES[ROUTE_TABLE.slot[idx] - 1];
+        if(route.path == path && route.method == method)
+            return route.handler;
+        idx = (idx + 1) & (ROUTE_SLOTS - 1);
+    }
+    return nullptr;
+}
+
+static_assert(LookupRoute("POST", "/login") == &UserHandler::Login, "route table");
+static_assert(LookupRoute("GET", "/login") == nullptr, "route table");
+
+} // namespace
+
+HttpRouter::Handler HttpRouter::Find(std::string_view method, std::string_view path) {
+    return LookupRoute(method, path);
+}
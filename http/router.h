@@ -0,0 +1,27 @@
+# pragma once
+
+#include <string_view>
+
+#include "../buffer/buffer.h"
+
+class HttpRequest;
+class HttpResponse;
+
+/*
+    动态接口的路由：按（方法，路径）精确匹配，查不到的请求照常按静态文件处理。
+    - 路由表是router.cpp中的一个constexpr数组，编译期按哈希值放进开放定址的槽位，
+      装载率不超过1/2，查找只算一次哈希、平均比较一两次，与路由数量无关；
+    - 处理函数是普通函数指针，不经过std::function，也不分配内存；
+    - HTTP/1.1和HTTP/2共用同一套路由（都经过HttpResponse::MakeResponse）。
+*/
+
+class HttpRouter {
+public:
+    // 处理函数用response的MakeFileResponse/MakeErrorResponse把完整响应写入buff；
+    // 总是在线程池中同步调用（各种Reactor模式都是），可以阻塞，不会占用事件循环线程；
+    // HTTP/2不支持流式响应，使用MakeStreamResponse的处理函数在HTTP/2下返回500
+    typedef void (*Handler)(const HttpRequest &request, HttpResponse &response, Buffer &buff);
+
+    // 没有注册时返回nullptr
+    static Handler Find(std::string_view method, std::string_view path);
+};
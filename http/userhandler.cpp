@@ -0,0 +1,177 @@
+#include "userhandler.h"
+
+#include <crypt.h>
+#include <sys/random.h>
+
+#include "../pool/sqlconnRAII.h"
+
+namespace {
+
+const char* WELCOME_PAGE = "/welcome.html";
+const char* ERROR_PAGE = "/error.html";
+const unsigned int ER_DUP_ENTRY = 1062;     // 主键冲突，用户名已存在
+
+int HexValue(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// 转义后才能放进SQL语句的引号中
+std::string Escape(MYSQL* sql, const std::string &s) {
+    std::string out(s.size() * 2 + 1, '\0');
+    out.resize(mysql_real_escape_string(sql, &out[0], s.data(), s.size()));
+    return out;
+}
+
+// crypt(3)盐值使用的字母表
+const char SALT_CHARS[] = "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+// 比较时间与内容无关，不泄露前缀匹配了多少
+bool ConstantTimeEqual(std::string_view a, std::string_view b) {
+    if(a.size() != b.size())
+        return false;
+    unsigned char diff = 0;
+    for(size_t i = 0; i < a.size(); i++)
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+} // namespace
+
+bool UserHandler::HashPassword(const std::string &password, std::string &hash) {
+    unsigned char rnd[SALT_LEN];
+    if(getrandom(rnd, sizeof(rnd), 0) != static_cast<ssize_t>(sizeof(rnd)))
+        return false;
+    std::string setting = "$6$";
+    for(unsigned char c : rnd)
+        setting.push_back(SALT_CHARS[c & 63]);
+    setting.push_back('$');
+
+    struct crypt_data data;
+    data.initialized = 0;
+    const char* out = crypt_r(password.data(), setting.data(), &data);
+    if(!out || out[0] != '$')
+        return false;
+    hash = out;
+    return true;
+}
+
+bool UserHandler::VerifyPassword(const std::string &password, std::string_view hash) {
+    // 只接受SHA-512 crypt格式，明文或其他格式的旧记录一律不通过
+    if(hash.size() < 4 || hash.compare(0, 3, "$6$") != 0)
+        return false;
+    std::string setting(hash);
+    struct crypt_data data;
+    data.initialized = 0;
+    const char* out = crypt_r(password.data(), setting.data(), &data);
+    return out && ConstantTimeEqual(out, hash);
+}
+
+bool UserHandler::FormValue(std::string_view form, std::string_view key, std::string &value) {
+    while(!form.empty()) {
+        size_t amp = form.find('&');
+        std::string_view pair = form.substr(0, amp);
+        form = amp == std::string_view::npos ? std::string_view() : form.substr(amp + 1);
+        size_t eq = pair.find('=');
+        if(eq == std::string_view::npos || pair.substr(0, eq) != key)
+            continue;
+
+        std::string_view encoded = pair.substr(eq + 1);
+        value.clear();
+        for(size_t i = 0; i < encoded.size(); i++) {
+            char c = encoded[i];
+            if(c == '+') {
+                value.push_back(' ');
+            }
+            else if(c == '%') {
+                if(i + 2 >= encoded.size())
+                    return false;
+                int hi = HexValue(encoded[i + 1]), lo = HexValue(encoded[i + 2]);
+                if(hi < 0 || lo < 0)
+                    return false;
+                value.push_back(static_cast<char>(hi * 16 + lo));
+                i += 2;
+            }
+            else {
+                value.push_back(c);
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool UserHandler::ParseForm_(const HttpRequest &request, std::string &user, std::string &password) {
+    std::string_view form = request.body();
+    if(!FormValue(form, "user", user) || !FormValue(form, "password", password))
+        return false;
+    // crypt(3)只处理到第一个'\0'，含%00的密码拒绝，免得只按前缀比较
+    return !user.empty() && !password.empty() &&
+           user.size() <= MAX_FIELD_LEN && password.size() <= MAX_FIELD_LEN &&
+           password.find('\0') == std::string::npos;
+}
+
+void UserHandler::Login(const HttpRequest &request, HttpResponse &response, Buffer &buff) {
+    std::string user, password;
+    if(!ParseForm_(request, user, password)) {
+        response.MakeErrorResponse(buff, 400, "Invalid login form");
+        return;
+    }
+    MYSQL* sql;
+    SqlConnRAII conn(&sql, SqlConnPool::Instance());
+    if(!sql) {
+        response.MakeErrorResponse(buff, 503, "Database unavailable");
+        return;
+    }
+
+    std::string query = "SELECT password FROM user WHERE username='" + Escape(sql, user) + "' LIMIT 1";
+    if(mysql_query(sql, query.data()) != 0) {
+        LOG_ERROR("Login query error: %s", mysql_error(sql));
+        response.MakeErrorResponse(buff, 500, "Database error");
+        return;
+    }
+    bool verified = false;
+    MYSQL_RES* res = mysql_store_result(sql);
+    if(res) {
+        MYSQL_ROW row = mysql_fetch_row(res);
+        unsigned long* lengths = mysql_fetch_lengths(res);
+        verified = row && row[0] && VerifyPassword(password, std::string_view(row[0], lengths[0]));
+        mysql_free_result(res);
+    }
+    LOG_INFO("Login %s %s", user.data(), verified ? "ok" : "failed");
+    response.MakeFileResponse(buff, verified ? WELCOME_PAGE : ERROR_PAGE, &request);
+}
+
+void UserHandler::Register(const HttpRequest &request, HttpResponse &response, Buffer &buff) {
+    std::string user, password;
+    if(!ParseForm_(request, user, password)) {
+        response.MakeErrorResponse(buff, 400, "Invalid register form");
+        return;
+    }
+    std::string hash;
+    if(!HashPassword(password, hash)) {
+        LOG_ERROR("Register hash error: %d", errno);
+        response.MakeErrorResponse(buff, 500, "Internal error");
+        return;
+    }
+    MYSQL* sql;
+    SqlConnRAII conn(&sql, SqlConnPool::Instance());
+    if(!sql) {
+        response.MakeErrorResponse(buff, 503, "Database unavailable");
+        return;
+    }
+
+    // 用户名是主键，直接插入，由数据库判断是否重名，不需要先查询
+    std::string query = "INSERT INTO user(username, password) VALUES('" +
+                        Escape(sql, user) + "', '" + Escape(sql, hash) + "')";
+    bool created = mysql_query(sql, query.data()) == 0;
+    if(!created && mysql_errno(sql) != ER_DUP_ENTRY) {
+        LOG_ERROR("Register query error: %s", mysql_error(sql));
+        response.MakeErrorResponse(buff, 500, "Database error");
+        return;
+    }
+    LOG_INFO("Register %s %s", user.data(), created ? "ok" : "exists");
+    response.MakeFileResponse(buff, created ? WELCOME_PAGE : ERROR_PAGE, &request);
+}
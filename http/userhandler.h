@@ -0,0 +1,36 @@
+# pragma once
+
+#include <string>
+#include <string_view>
+
+#include "../buffer/buffer.h"
+#include "httprequest.h"
+#include "httpresponse.h"
+
+/*
+    登录、注册接口：表单以application/x-www-form-urlencoded提交user和password，
+    通过SqlConnPool查询user表（username为主键）。
+    password列保存crypt(3)的SHA-512加盐哈希（"$6$盐$..."，106字节，列宽至少VARCHAR(128)），不保存明文。
+    成功时返回welcome.html，用户名或密码不对、用户名已存在时返回error.html；
+    没有可用的数据库连接时返回503。
+*/
+
+class UserHandler {
+public:
+    static void Login(const HttpRequest &request, HttpResponse &response, Buffer &buff);
+    static void Register(const HttpRequest &request, HttpResponse &response, Buffer &buff);
+
+    // 从表单中取出key对应的值并做URL解码，不存在或编码错误时返回false
+    static bool FormValue(std::string_view form, std::string_view key, std::string &value);
+
+    // 用随机盐生成password的SHA-512 crypt哈希；取随机数失败时返回false
+    static bool HashPassword(const std::string &password, std::string &hash);
+    // password与保存的哈希是否一致
+    static bool VerifyPassword(const std::string &password, std::string_view hash);
+
+    static const size_t MAX_FIELD_LEN = 64;
+    static const size_t SALT_LEN = 16;
+
+private:
+    static bool ParseForm_(const HttpRequest &request, std::string &user, std::string &password);
+};
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "userhandler.h"
+#include "../buffer/buffer.h"
+
+// 解析一个表单POST请求并调用Login，返回响应状态码
+static int LoginWithForm(const std::string &form) {
+    Buffer in;
+    in.Append("POST /login HTTP/1.1\r\nHost: x\r\n"
+              "Content-Type: application/x-www-form-urlencoded\r\n"
+              "Content-Length: " + std::to_string(form.size()) + "\r\n\r\n" + form);
+    HttpRequest request;
+    EXPECT_EQ(request.parse(in), HttpRequest::PARSE_OK);
+    HttpResponse response;
+    response.Init("/tmp", request.path(), true, 200);
+    Buffer out;
+    UserHandler::Login(request, response, out);
+    return response.Code();
+}
+
+TEST(UserHandlerTest, FormValueDecode) {
+    std::string value;
+    ASSERT_TRUE(UserHandler::FormValue("user=a+b%41%2b&password=x", "user", value));
+    EXPECT_EQ(value, "a bA+");
+    ASSERT_TRUE(UserHandler::FormValue("user=a&password=p%3D1", "password", value));
+    EXPECT_EQ(value, "p=1");
+    ASSERT_TRUE(UserHandler::FormValue("a=1&user=&b=2", "user", value));
+    EXPECT_EQ(value, "");
+    // 键必须完全相同
+    EXPECT_FALSE(UserHandler::FormValue("username=a&xuser=b", "user", value));
+    EXPECT_FALSE(UserHandler::FormValue("user&password=x", "user", value));
+    EXPECT_FALSE(UserHandler::FormValue("", "user", value));
+}
+
+TEST(UserHandlerTest, FormValueBadEscape) {
+    std::string value;
+    EXPECT_FALSE(UserHandler::FormValue("user=%", "user", value));
+    EXPECT_FALSE(UserHandler::FormValue("user=a%4", "user", value));
+    EXPECT_FALSE(UserHandler::FormValue("user=%4&password=x", "user", value));
+    EXPECT_FALSE(UserHandler::FormValue("user=%zz", "user", value));
+    EXPECT_FALSE(UserHandler::FormValue("user=%g1", "user", value));
+    // 其他字段的编码错误不影响
+    ASSERT_TRUE(UserHandler::FormValue("password=%zz&user=ok", "user", value));
+    EXPECT_EQ(value, "ok");
+}
+
+// 含%00的密码在访问数据库之前就被拒绝
+TEST(UserHandlerTest, RejectNulInPassword) {
+    std::string value;
+    ASSERT_TRUE(UserHandler::FormValue("password=a%00b", "password", value));
+    EXPECT_EQ(value, std::string("a\0b", 3));
+
+    EXPECT_EQ(LoginWithForm("user=alice&password=a%00b"), 400);
+    EXPECT_EQ(LoginWithForm("user=alice&password=%00"), 400);
+    EXPECT_EQ(LoginWithForm("user=alice&password=%zz"), 400);
+    EXPECT_EQ(LoginWithForm("user=&password=x"), 400);
+    EXPECT_EQ(LoginWithForm("user=alice&password=" + std::string(UserHandler::MAX_FIELD_LEN + 1, 'p')), 400);
+}
+
+TEST(UserHandlerTest, HashRoundTrip) {
+    std::string hash, hash2;
+    ASSERT_TRUE(UserHandler::HashPassword("s3cret pw", hash));
+    EXPECT_EQ(hash.compare(0, 3, "$6$"), 0);
+    EXPECT_EQ(hash.size(), 3 + UserHandler::SALT_LEN + 1 + 86);
+    EXPECT_TRUE(UserHandler::VerifyPassword("s3cret pw", hash));
+    EXPECT_FALSE(UserHandler::VerifyPassword("s3cret pW", hash));
+    EXPECT_FALSE(UserHandler::VerifyPassword("", hash));
+
+    // 随机盐，同一密码两次哈希不同，但都能验证
+    ASSERT_TRUE(UserHandler::HashPassword("s3cret pw", hash2));
+    EXPECT_NE(hash, hash2);
+    EXPECT_TRUE(UserHandler::VerifyPassword("s3cret pw", hash2));
+
+    // 明文或其他格式的记录不通过
+    EXPECT_FALSE(UserHandler::VerifyPassword("s3cret pw", "s3cret pw"));
+    EXPECT_FALSE(UserHandler::VerifyPassword("s3cret pw", "$1$abc$def"));
+    EXPECT_FALSE(UserHandler::VerifyPassword("s3cret pw", ""));
+    EXPECT_FALSE(UserHandler::VerifyPassword("s3cret pw", hash.substr(0, hash.size() - 1)));
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,457 @@
+#include "hpack.h"
+
+#include <algorithm>
+
+namespace {
+
+// 附录A：静态表，索引从1开始
+struct StaticEntry {
+    std::string_view name;
+    std::string_view value;
+};
+
+const StaticEntry STATIC_TABLE[] = {
+    { ":authority",                    ""               },   // 1
+    { ":method",                       "GET"            },   // 2
+    { ":method",                       "POST"           },   // 3
+    { ":path",                         "/"              },   // 4
+    { ":path",                         "/index.html"    },   // 5
+    { ":scheme",                       "http"           },   // 6
+    { ":scheme",                       "https"          },   // 7
+    { ":status",                       "200"            },   // 8
+    { ":status",                       "204"            },   // 9
+    { ":status",                       "206"            },   // 10
+    { ":status",                       "304"            },   // 11
+    { ":status",                       "400"            },   // 12
+    { ":status",                       "404"            },   // 13
+    { ":status",                       "500"            },   // 14
+    { "accept-charset",                ""               },   // 15
+    { "accept-encoding",               "gzip, deflate"  },   // 16
+    { "accept-language",               ""               },   // 17
+    { "accept-ranges",                 ""               },   // 18
+    { "accept",                        ""               },   // 19
+    { "access-control-allow-origin",   ""               },   // 20
+    { "age",                           ""               },   // 21
+    { "allow",                         ""               },   // 22
+    { "authorization",                 ""               },   // 23
+    { "cache-control",                 ""               },   // 24
+    { "content-disposition",           ""               },   // 25
+    { "content-encoding",              ""               },   // 26
+    { "content-language",              ""               },   // 27
+    { "content-length",                ""               },   // 28
+    { "content-location",              ""               },   // 29
+    { "content-range",                 ""               },   // 30
+    { "content-type",                  ""               },   // 31
+    { "cookie",                        ""               },   // 32
+    { "date",                          ""               },   // 33
+    { "etag",                          ""               },   // 34
+    { "expect",                        ""               },   // 35
+    { "expires",                       ""               },   // 36
+    { "from",                          ""               },   // 37
+    { "host",                          ""               },   // 38
+    { "if-match",                      ""               },   // 39
+    { "if-modified-since",             ""               },   // 40
+    { "if-none-match",                 ""               },   // 41
+    { "if-range",                      ""               },   // 42
+    { "if-unmodified-since",           ""               },   // 43
+    { "last-modified",                 ""               },   // 44
+    { "link",                          ""               },   // 45
+    { "location",                      ""               },   // 46
+    { "max-forwards",                  ""               },   // 47
+    { "proxy-authenticate",            ""               },   // 48
+    { "proxy-authorization",           ""               },   // 49
+    { "range",                         ""               },   // 50
+    { "referer",                       ""               },   // 51
+    { "refresh",                       ""               },   // 52
+    { "retry-after",                   ""               },   // 53
+    { "server",                        ""               },   // 54
+    { "set-cookie",                    ""               },   // 55
+    { "strict-transport-security",     ""               },   // 56
+    { "transfer-encoding",             ""               },   // 57
+    { "user-agent",                    ""               },   // 58
+    { "vary",                          ""               },   // 59
+    { "via",                           ""               },   // 60
+    { "www-authenticate",              ""               },   // 61
+};
+
+const size_t STATIC_NUM = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+// 附录B：Huffman编码表，最后一项为EOS（256）
+struct HuffCode {
+    uint32_t code;
+    uint8_t len;
+};
+
+const HuffCode HUFFMAN_CODES[257] = {
+    { 0x00001ff8, 13 }, { 0x007fffd8, 23 }, { 0x0fffffe2, 28 }, { 0x0fffffe3, 28 },
+    { 0x0fffffe4, 28 }, { 0x0fffffe5, 28 }, { 0x0fffffe6, 28 }, { 0x0fffffe7, 28 },
+    { 0x0fffffe8, 28 }, { 0x00ffffea, 24 }, { 0x3ffffffc, 30 }, { 0x0fffffe9, 28 },
+    { 0x0fffffea, 28 }, { 0x3ffffffd, 30 }, { 0x0fffffeb, 28 }, { 0x0fffffec, 28 },
+    { 0x0fffffed, 28 }, { 0x0fffffee, 28 }, { 0x0fffffef, 28 }, { 0x0ffffff0, 28 },
+    { 0x0ffffff1, 28 }, { 0x0ffffff2, 28 }, { 0x3ffffffe, 30 }, { 0x0ffffff3, 28 },
+    { 0x0ffffff4, 28 }, { 0x0ffffff5, 28 }, { 0x0ffffff6, 28 }, { 0x0ffffff7, 28 },
+    { 0x0ffffff8, 28 }, { 0x0ffffff9, 28 }, { 0x0ffffffa, 28 }, { 0x0ffffffb, 28 },
+    { 0x00000014,  6 }, { 0x000003f8, 10 }, { 0x000003f9, 10 }, { 0x00000ffa, 12 },
+    { 0x00001ff9, 13 }, { 0x00000015,  6 }, { 0x000000f8,  8 }, { 0x000007fa, 11 },
+    { 0x000003fa, 10 }, { 0x000003fb, 10 }, { 0x000000f9,  8 }, { 0x000007fb, 11 },
+    { 0x000000fa,  8 }, { 0x00000016,  6 }, { 0x00000017,  6 }, { 0x00000018,  6 },
+    { 0x00000000,  5 }, { 0x00000001,  5 }, { 0x00000002,  5 }, { 0x00000019,  6 },
+    { 0x0000001a,  6 }, { 0x0000001b,  6 }, { 0x0000001c,  6 }, { 0x0000001d,  6 },
+    { 0x0000001e,  6 }, { 0x0000001f,  6 }, { 0x0000005c,  7 }, { 0x000000fb,  8 },
+    { 0x00007ffc, 15 }, { 0x00000020,  6 }, { 0x00000ffb, 12 }, { 0x000003fc, 10 },
+    { 0x00001ffa, 13 }, { 0x00000021,  6 }, { 0x0000005d,  7 }, { 0x0000005e,  7 },
+    { 0x0000005f,  7 }, { 0x00000060,  7 }, { 0x00000061,  7 }, { 0x00000062,  7 },
+    { 0x00000063,  7 }, { 0x00000064,  7 }, { 0x00000065,  7 }, { 0x00000066,  7 },
+    { 0x00000067,  7 }, { 0x00000068,  7 }, { 0x00000069,  7 }, { 0x0000006a,  7 },
+    { 0x0000006b,  7 }, { 0x0000006c,  7 }, { 0x0000006d,  7 }, { 0x0000006e,  7 },
+    { 0x0000006f,  7 }, { 0x00000070,  7 }, { 0x00000071,  7 }, { 0x00000072,  7 },
+    { 0x000000fc,  8 }, { 0x00000073,  7 }, { 0x000000fd,  8 }, { 0x00001ffb, 13 },
+    { 0x0007fff0, 19 }, { 0x00001ffc, 13 }, { 0x00003ffc, 14 }, { 0x00000022,  6 },
+    { 0x00007ffd, 15 }, { 0x00000003,  5 }, { 0x00000023,  6 }, { 0x00000004,  5 },
+    { 0x00000024,  6 }, { 0x00000005,  5 }, { 0x00000025,  6 }, { 0x00000026,  6 },
+    { 0x00000027,  6 }, { 0x00000006,  5 }, { 0x00000074,  7 }, { 0x00000075,  7 },
+    { 0x00000028,  6 }, { 0x00000029,  6 }, { 0x0000002a,  6 }, { 0x00000007,  5 },
+    { 0x0000002b,  6 }, { 0x00000076,  7 }, { 0x0000002c,  6 }, { 0x00000008,  5 },
+    { 0x00000009,  5 }, { 0x0000002d,  6 }, { 0x00000077,  7 }, { 0x00000078,  7 },
+    { 0x00000079,  7 }, { 0x0000007a,  7 }, { 0x0000007b,  7 }, { 0x00007ffe, 15 },
+    { 0x000007fc, 11 }, { 0x00003ffd, 14 }, { 0x00001ffd, 13 }, { 0x0ffffffc, 28 },
+    { 0x000fffe6, 20 }, { 0x003fffd2, 22 }, { 0x000fffe7, 20 }, { 0x000fffe8, 20 },
+    { 0x003fffd3, 22 }, { 0x003fffd4, 22 }, { 0x003fffd5, 22 }, { 0x007fffd9, 23 },
+    { 0x003fffd6, 22 }, { 0x007fffda, 23 }, { 0x007fffdb, 23 }, { 0x007fffdc, 23 },
+    { 0x007fffdd, 23 }, { 0x007fffde, 23 }, { 0x00ffffeb, 24 }, { 0x007fffdf, 23 },
+    { 0x00ffffec, 24 }, { 0x00ffffed, 24 }, { 0x003fffd7, 22 }, { 0x007fffe0, 23 },
+    { 0x00ffffee, 24 }, { 0x007fffe1, 23 }, { 0x007fffe2, 23 }, { 0x007fffe3, 23 },
+    { 0x007fffe4, 23 }, { 0x001fffdc, 21 }, { 0x003fffd8, 22 }, { 0x007fffe5, 23 },
+    { 0x003fffd9, 22 }, { 0x007fffe6, 23 }, { 0x007fffe7, 23 }, { 0x00ffffef, 24 },
+    { 0x003fffda, 22 }, { 0x001fffdd, 21 }, { 0x000fffe9, 20 }, { 0x003fffdb, 22 },
+    { 0x003fffdc, 22 }, { 0x007fffe8, 23 }, { 0x007fffe9, 23 }, { 0x001fffde, 21 },
+    { 0x007fffea, 23 }, { 0x003fffdd, 22 }, { 0x003fffde, 22 }, { 0x00fffff0, 24 },
+    { 0x001fffdf, 21 }, { 0x003fffdf, 22 }, { 0x007fffeb, 23 }, { 0x007fffec, 23 },
+    { 0x001fffe0, 21 }, { 0x001fffe1, 21 }, { 0x003fffe0, 22 }, { 0x001fffe2, 21 },
+    { 0x007fffed, 23 }, { 0x003fffe1, 22 }, { 0x007fffee, 23 }, { 0x007fffef, 23 },
+    { 0x000fffea, 20 }, { 0x003fffe2, 22 }, { 0x003fffe3, 22 }, { 0x003fffe4, 22 },
+    { 0x007ffff0, 23 }, { 0x003fffe5, 22 }, { 0x003fffe6, 22 }, { 0x007ffff1, 23 },
+    { 0x03ffffe0, 26 }, { 0x03ffffe1, 26 }, { 0x000fffeb, 20 }, { 0x0007fff1, 19 },
+    { 0x003fffe7, 22 }, { 0x007ffff2, 23 }, { 0x003fffe8, 22 }, { 0x01ffffec, 25 },
+    { 0x03ffffe2, 26 }, { 0x03ffffe3, 26 }, { 0x03ffffe4, 26 }, { 0x07ffffde, 27 },
+    { 0x07ffffdf, 27 }, { 0x03ffffe5, 26 }, { 0x00fffff1, 24 }, { 0x01ffffed, 25 },
+    { 0x0007fff2, 19 }, { 0x001fffe3, 21 }, { 0x03ffffe6, 26 }, { 0x07ffffe0, 27 },
+    { 0x07ffffe1, 27 }, { 0x03ffffe7, 26 }, { 0x07ffffe2, 27 }, { 0x00fffff2, 24 },
+    { 0x001fffe4, 21 }, { 0x001fffe5, 21 }, { 0x03ffffe8, 26 }, { 0x03ffffe9, 26 },
+    { 0x0ffffffd, 28 }, { 0x07ffffe3, 27 }, { 0x07ffffe4, 27 }, { 0x07ffffe5, 27 },
+    { 0x000fffec, 20 }, { 0x00fffff3, 24 }, { 0x000fffed, 20 }, { 0x001fffe6, 21 },
+    { 0x003fffe9, 22 }, { 0x001fffe7, 21 }, { 0x001fffe8, 21 }, { 0x007ffff3, 23 },
+    { 0x003fffea, 22 }, { 0x003fffeb, 22 }, { 0x01ffffee, 25 }, { 0x01ffffef, 25 },
+    { 0x00fffff4, 24 }, { 0x00fffff5, 24 }, { 0x03ffffea, 26 }, { 0x007ffff4, 23 },
+    { 0x03ffffeb, 26 }, { 0x07ffffe6, 27 }, { 0x03ffffec, 26 }, { 0x03ffffed, 26 },
+    { 0x07ffffe7, 27 }, { 0x07ffffe8, 27 }, { 0x07ffffe9, 27 }, { 0x07ffffea, 27 },
+    { 0x07ffffeb, 27 }, { 0x0ffffffe, 28 }, { 0x07ffffec, 27 }, { 0x07ffffed, 27 },
+    { 0x07ffffee, 27 }, { 0x07ffffef, 27 }, { 0x07fffff0, 27 }, { 0x03ffffee, 26 },
+    { 0x3fffffff, 30 },
+};
+
+const int HUFFMAN_EOS = 256;
+
+// 解码用的二叉树，每个内部结点两个孩子，叶子结点记录符号
+struct HuffTree {
+    struct Node {
+        int16_t child[2];
+        int16_t sym;
+    };
+    std::vector<Node> nodes;
+
+    HuffTree() {
+        nodes.push_back({ { -1, -1 }, -1 });
+        for(int sym = 0; sym <= HUFFMAN_EOS; sym++) {
+            const HuffCode &h = HUFFMAN_CODES[sym];
+            int cur = 0;
+            for(int b = h.len - 1; b >= 0; b--) {
+                int bit = (h.code >> b) & 1;
+                if(nodes[cur].child[bit] < 0) {
+                    nodes[cur].child[bit] = static_cast<int16_t>(nodes.size());
+                    nodes.push_back({ { -1, -1 }, -1 });
+                }
+                cur = nodes[cur].child[bit];
+            }
+            nodes[cur].sym = static_cast<int16_t>(sym);
+        }
+    }
+};
+
+const HuffTree& Tree() {
+    static const HuffTree tree;
+    return tree;
+}
+
+} // namespace
+
+namespace Hpack {
+
+bool HuffmanDecode(std::string_view in, std::string &out) {
+    const std::vector<HuffTree::Node> &nodes = Tree().nodes;
+    int cur = 0;
+    int depth = 0;              // 当前未完成符号已读的位数
+    bool allOnes = true;
+    for(unsigned char c : in) {
+        for(int b = 7; b >= 0; b--) {
+            int bit = (c >> b) & 1;
+            cur = nodes[cur].child[bit];
+            if(cur < 0)
+                return false;
+            depth++;
+            allOnes = allOnes && bit;
+            int sym = nodes[cur].sym;
+            if(sym >= 0) {
+                if(sym == HUFFMAN_EOS)
+                    return false;
+                out.push_back(static_cast<char>(sym));
+                cur = 0;
+                depth = 0;
+                allOnes = true;
+            }
+        }
+    }
+    // 剩下的是填充：EOS编码的前缀，即不超过7个1
+    return depth <= 7 && allOnes;
+}
+
+void HuffmanEncode(std::string_view in, std::string &out) {
+    uint64_t acc = 0;
+    int bits = 0;
+    for(unsigned char c : in) {
+        const HuffCode &h = HUFFMAN_CODES[c];
+        acc = (acc << h.len) | h.code;
+        bits += h.len;
+        while(bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    if(bits > 0)
+        out.push_back(static_cast<char>((acc << (8 - bits)) | (0xff >> bits)));
+}
+
+size_t HuffmanEncodedLen(std::string_view in) {
+    size_t bits = 0;
+    for(unsigned char c : in)
+        bits += HUFFMAN_CODES[c].len;
+    return (bits + 7) / 8;
+}
+
+void EncodeInt(uint64_t value, int prefix, uint8_t first, std::string &out) {
+    const uint64_t max = (1u << prefix) - 1;
+    if(value < max) {
+        out.push_back(static_cast<char>(first | value));
+        return;
+    }
+    out.push_back(static_cast<char>(first | max));
+    value -= max;
+    while(value >= 128) {
+        out.push_back(static_cast<char>(0x80 | (value & 0x7f)));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool DecodeInt(const uint8_t* &p, const uint8_t* end, int prefix, uint64_t &value) {
+    if(p >= end)
+        return false;
+    const uint64_t max = (1u << prefix) - 1;
+    value = *p++ & max;
+    if(value < max)
+        return true;
+    // 续字节最多5个，足够表示32位以内的值
+    for(int shift = 0; p < end && shift <= 28; shift += 7) {
+        uint8_t b = *p++;
+        value += static_cast<uint64_t>(b & 0x7f) << shift;
+        if(!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+} // namespace Hpack
+
+void HpackTable::Add(std::string_view name, std::string_view value) {
+    size_t size = name.size() + value.size() + Hpack::ENTRY_OVERHEAD;
+    // 比整张表还大的条目使表清空，本身也不加入
+    Evict_(size);
+    if(size > maxSize_)
+        return;
+    entries_.push_front({ std::string(name), std::string(value) });
+    size_ += size;
+}
+
+void HpackTable::SetMaxSize(size_t maxSize) {
+    maxSize_ = maxSize;
+    Evict_(0);
+}
+
+void HpackTable::Evict_(size_t need) {
+    while(!entries_.empty() && size_ + need > maxSize_) {
+        const HeaderField &last = entries_.back();
+        size_ -= last.name.size() + last.value.size() + Hpack::ENTRY_OVERHEAD;
+        entries_.pop_back();
+    }
+}
+
+HpackDecoder::HpackDecoder(size_t maxTableSize, size_t maxHeaderListSize):
+    table_(maxTableSize), maxTableSize_(maxTableSize), maxHeaderListSize_(maxHeaderListSize) {
+}
+
+bool HpackDecoder::Lookup_(uint64_t index, std::string_view &name, std::string_view &value) const {
+    if(index == 0)
+        return false;
+    if(index <= STATIC_NUM) {
+        name = STATIC_TABLE[index - 1].name;
+        value = STATIC_TABLE[index - 1].value;
+        return true;
+    }
+    index -= STATIC_NUM + 1;
+    if(index >= table_.Count())
+        return false;
+    name = table_.Get(index).name;
+    value = table_.Get(index).value;
+    return true;
+}
+
+bool HpackDecoder::ReadString_(const uint8_t* &p, const uint8_t* end, std::string &out) {
+    if(p >= end)
+        return false;
+    bool huffman = *p & 0x80;
+    uint64_t len;
+    if(!Hpack::DecodeInt(p, end, 7, len) || len > static_cast<uint64_t>(end - p))
+        return false;
+    std::string_view raw(reinterpret_cast<const char*>(p), len);
+    p += len;
+    out.clear();
+    if(huffman)
+        return Hpack::HuffmanDecode(raw, out);
+    out.assign(raw.data(), raw.size());
+    return true;
+}
+
+bool HpackDecoder::Decode(std::string_view block, std::vector<HeaderField> &headers) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(block.data());
+    const uint8_t* end = p + block.size();
+    size_t listSize = 0;
+    bool fieldSeen = false;
+    while(p < end) {
+        uint8_t b = *p;
+        if(b & 0x80) {
+            // 索引表示
+            uint64_t index;
+            std::string_view name, value;
+            if(!Hpack::DecodeInt(p, end, 7, index) || !Lookup_(index, name, value))
+                return false;
+            headers.push_back({ std::string(name), std::string(value) });
+        }
+        else if((b & 0xe0) == 0x20) {
+            // 动态表大小更新，只能出现在头块开头
+            uint64_t size;
+            if(fieldSeen || !Hpack::DecodeInt(p, end, 5, size) || size > maxTableSize_)
+                return false;
+            table_.SetMaxSize(size);
+            continue;
+        }
+        else {
+            // 字面量：01带增量索引，0000不索引，0001永不索引
+            bool index = (b & 0xc0) == 0x40;
+            uint64_t nameIndex;
+            if(!Hpack::DecodeInt(p, end, index ? 6 : 4, nameIndex))
+                return false;
+            HeaderField field;
+            if(nameIndex > 0) {
+                std::string_view name, value;
+                if(!Lookup_(nameIndex, name, value))
+                    return false;
+                field.name.assign(name.data(), name.size());
+            }
+            else if(!ReadString_(p, end, field.name)) {
+                return false;
+            }
+            if(!ReadString_(p, end, field.value))
+                return false;
+            if(index)
+                table_.Add(field.name, field.value);
+            headers.push_back(std::move(field));
+        }
+        fieldSeen = true;
+        listSize += headers.back().name.size() + headers.back().value.size() + Hpack::ENTRY_OVERHEAD;
+        if(listSize > maxHeaderListSize_)
+            return false;
+    }
+    return true;
+}
+
+HpackEncoder::HpackEncoder(): table_(Hpack::DEFAULT_TABLE_SIZE), sizeUpdate_(false),
+    minSize_(Hpack::DEFAULT_TABLE_SIZE) {
+}
+
+// 本端最多使用默认大小的表；两个头块之间大小先变小再变大时，要先发出最小值
+void HpackEncoder::SetMaxTableSize(size_t size) {
+    size = std::min(size, Hpack::DEFAULT_TABLE_SIZE);
+    if(size == table_.MaxSize() && !sizeUpdate_)
+        return;
+    minSize_ = sizeUpdate_ ? std::min(minSize_, size) : size;
+    sizeUpdate_ = true;
+    table_.SetMaxSize(size);
+}
+
+void HpackEncoder::BeginBlock(std::string &out) {
+    if(!sizeUpdate_)
+        return;
+    if(minSize_ < table_.MaxSize())
+        Hpack::EncodeInt(minSize_, 5, 0x20, out);
+    Hpack::EncodeInt(table_.MaxSize(), 5, 0x20, out);
+    sizeUpdate_ = false;
+}
+
+void HpackEncoder::Encode(std::string_view name, std::string_view value, std::string &out) {
+    uint64_t nameIndex = 0;
+    for(size_t i = 0; i < STATIC_NUM; i++) {
+        if(STATIC_TABLE[i].name != name)
+            continue;
+        if(STATIC_TABLE[i].value == value) {
+            Hpack::EncodeInt(i + 1, 7, 0x80, out);
+            return;
+        }
+        if(nameIndex == 0)
+            nameIndex = i + 1;
+    }
+    for(size_t i = 0; i < table_.Count(); i++) {
+        const HeaderField &field = table_.Get(i);
+        if(field.name != name)
+            continue;
+        if(field.value == value) {
+            Hpack::EncodeInt(STATIC_NUM + 1 + i, 7, 0x80, out);
+            return;
+        }
+        if(nameIndex == 0)
+            nameIndex = STATIC_NUM + 1 + i;
+    }
+
+    // 大的条目会挤掉很多小条目，直接发不索引的字面量
+    bool index = name.size() + value.size() + Hpack::ENTRY_OVERHEAD <= table_.MaxSize() / 4;
+    if(index)
+        Hpack::EncodeInt(nameIndex, 6, 0x40, out);
+    else
+        Hpack::EncodeInt(nameIndex, 4, 0x00, out);
+    if(nameIndex == 0)
+        EncodeString_(name, out);
+    EncodeString_(value, out);
+    if(index)
+        table_.Add(name, value);
+}
+
+void HpackEncoder::EncodeString_(std::string_view s, std::string &out) {
+    size_t huffLen = Hpack::HuffmanEncodedLen(s);
+    if(huffLen < s.size()) {
+        Hpack::EncodeInt(huffLen, 7, 0x80, out);
+        Hpack::HuffmanEncode(s, out);
+    }
+    else {
+        Hpack::EncodeInt(s.size(), 7, 0x00, out);
+        out.append(s.data(), s.size());
+    }
+}
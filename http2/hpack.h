@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+
+/*
+    HPACK头部压缩（RFC 7541）：
+    - HpackDecoder解码对端发来的头块，维护对端编码器对应的动态表；
+    - HpackEncoder编码本端的头部：静态表或动态表中有完全相同的项时只发索引，
+      否则发带增量索引的字面量（名字尽量用索引），字符串在Huffman编码更短时使用Huffman编码。
+    两个方向各有一张动态表，互不相关。
+*/
+
+struct HeaderField {
+    std::string name;
+    std::string value;
+};
+
+namespace Hpack {
+
+// 条目大小 = 名字长度 + 值长度 + 32
+const size_t ENTRY_OVERHEAD = 32;
+const size_t DEFAULT_TABLE_SIZE = 4096;
+
+// in中有非法编码（EOS、超过7位或不全为1的填充）时返回false
+bool HuffmanDecode(std::string_view in, std::string &out);
+void HuffmanEncode(std::string_view in, std::string &out);
+size_t HuffmanEncodedLen(std::string_view in);
+
+// 整数表示：首字节低prefix位起编码，first为首字节中已有的标志位
+void EncodeInt(uint64_t value, int prefix, uint8_t first, std::string &out);
+bool DecodeInt(const uint8_t* &p, const uint8_t* end, int prefix, uint64_t &value);
+
+} // namespace Hpack
+
+// 动态表，下标0为最新加入的条目
+class HpackTable {
+public:
+    explicit HpackTable(size_t maxSize = Hpack::DEFAULT_TABLE_SIZE): size_(0), maxSize_(maxSize) {}
+
+    void Add(std::string_view name, std::string_view value);
+    void SetMaxSize(size_t maxSize);
+    const HeaderField& Get(size_t i) const { return entries_[i]; }
+    size_t Count() const { return entries_.size(); }
+    size_t Size() const { return size_; }
+    size_t MaxSize() const { return maxSize_; }
+
+private:
+    void Evict_(size_t need);
+
+    std::deque<HeaderField> entries_;
+    size_t size_;
+    size_t maxSize_;
+};
+
+class HpackDecoder {
+public:
+    // maxTableSize为本端SETTINGS_HEADER_TABLE_SIZE，对端的表大小更新不能超过它
+    explicit HpackDecoder(size_t maxTableSize = Hpack::DEFAULT_TABLE_SIZE,
+                          size_t maxHeaderListSize = 64 * 1024);
+
+    // 解码一个完整的头块，头部依次追加到headers；出错时返回false，连接应以COMPRESSION_ERROR关闭
+    bool Decode(std::string_view block, std::vector<HeaderField> &headers);
+
+    const HpackTable& Table() const { return table_; }
+
+private:
+    bool Lookup_(uint64_t index, std::string_view &name, std::string_view &value) const;
+    bool ReadString_(const uint8_t* &p, const uint8_t* end, std::string &out);
+
+    HpackTable table_;
+    size_t maxTableSize_;
+    size_t maxHeaderListSize_;
+};
+
+class HpackEncoder {
+public:
+    HpackEncoder();
+
+    // 对端SETTINGS_HEADER_TABLE_SIZE变化时调用，表大小更新在下一个头块开头发出
+    void SetMaxTableSize(size_t size);
+
+    // 每个头块开始时调用一次
+    void BeginBlock(std::string &out);
+    // name须为小写
+    void Encode(std::string_view name, std::string_view value, std::string &out);
+
+    const HpackTable& Table() const { return table_; }
+
+private:
+    void EncodeString_(std::string_view s, std::string &out);
+
+    HpackTable table_;
+    bool sizeUpdate_;           // 有未发出的表大小更新
+    size_t minSize_;            // 两个头块之间出现过的最小表大小，需要先发出
+};
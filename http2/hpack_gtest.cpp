@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include "hpack.h"
+
+static std::string FromHex(const std::string &hex) {
+    std::string out;
+    for(size_t i = 0; i + 1 < hex.size(); i += 2)
+        out.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    return out;
+}
+
+static std::string ToHex(const std::string &bin) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for(unsigned char c : bin) {
+        out.push_back(digits[c >> 4]);
+        out.push_back(digits[c & 0xf]);
+    }
+    return out;
+}
+
+typedef std::vector<std::pair<std::string, std::string>> Fields;
+
+static Fields Decode(HpackDecoder &decoder, const std::string &hex) {
+    std::vector<HeaderField> headers;
+    EXPECT_TRUE(decoder.Decode(FromHex(hex), headers));
+    Fields fields;
+    for(const HeaderField &h : headers)
+        fields.push_back({ h.name, h.value });
+    return fields;
+}
+
+// RFC 7541 C.1
+TEST(HpackTest, Integer) {
+    std::string out;
+    Hpack::EncodeInt(10, 5, 0, out);
+    EXPECT_EQ(ToHex(out), "0a");
+    out.clear();
+    Hpack::EncodeInt(1337, 5, 0, out);
+    EXPECT_EQ(ToHex(out), "1f9a0a");
+    out.clear();
+    Hpack::EncodeInt(42, 8, 0, out);
+    EXPECT_EQ(ToHex(out), "2a");
+
+    std::string in = FromHex("1f9a0a");
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(in.data());
+    uint64_t value = 0;
+    EXPECT_TRUE(Hpack::DecodeInt(p, p + in.size(), 5, value));
+    EXPECT_EQ(value, 1337u);
+}
+
+TEST(HpackTest, Huffman) {
+    std::string out;
+    Hpack::HuffmanEncode("www.example.com", out);
+    EXPECT_EQ(ToHex(out), "f1e3c2e5f23a6ba0ab90f4ff");
+    out.clear();
+    Hpack::HuffmanEncode("no-cache", out);
+    EXPECT_EQ(ToHex(out), "a8eb10649cbf");
+
+    std::string decoded;
+    EXPECT_TRUE(Hpack::HuffmanDecode(FromHex("a8eb10649cbf"), decoded));
+    EXPECT_EQ(decoded, "no-cache");
+
+    // 所有字节值往返
+    std::string all;
+    for(int i = 0; i < 256; i++)
+        all.push_back(static_cast<char>(i));
+    out.clear();
+    decoded.clear();
+    Hpack::HuffmanEncode(all, out);
+    EXPECT_EQ(out.size(), Hpack::HuffmanEncodedLen(all));
+    EXPECT_TRUE(Hpack::HuffmanDecode(out, decoded));
+    EXPECT_EQ(decoded, all);
+
+    // 填充超过7位、填充不全为1都是错误
+    decoded.clear();
+    EXPECT_FALSE(Hpack::HuffmanDecode(FromHex("a8eb10649cbfff"), decoded));
+    decoded.clear();
+    EXPECT_FALSE(Hpack::HuffmanDecode(FromHex("1e"), decoded));   // "0"后的填充为0
+}
+
+// RFC 7541 C.4：带Huffman编码的请求，三个头块共用一个动态表
+TEST(HpackTest, RequestsWithHuffman) {
+    HpackDecoder decoder;
+    EXPECT_EQ(Decode(decoder, "828684418cf1e3c2e5f23a6ba0ab90f4ff"),
+              (Fields{ { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" },
+                       { ":authority", "www.example.com" } }));
+    EXPECT_EQ(decoder.Table().Size(), 57u);
+
+    EXPECT_EQ(Decode(decoder, "828684be5886a8eb10649cbf"),
+              (Fields{ { ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" },
+                       { ":authority", "www.example.com" }, { "cache-control", "no-cache" } }));
+    EXPECT_EQ(decoder.Table().Size(), 110u);
+
+    EXPECT_EQ(Decode(decoder, "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"),
+              (Fields{ { ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" },
+                       { ":authority", "www.example.com" }, { "custom-key", "custom-value" } }));
+    EXPECT_EQ(decoder.Table().Size(), 164u);
+    EXPECT_EQ(decoder.Table().Get(0).name, "custom-key");
+}
+
+// RFC 7541 C.6：带Huffman编码的响应，动态表只有256字节，会发生淘汰
+TEST(HpackTest, ResponsesWithHuffman) {
+    HpackDecoder decoder(256);
+    const std::string date1 = "Mon, 21 Oct 2013 20:13:21 GMT";
+    const std::string date2 = "Mon, 21 Oct 2013 20:13:22 GMT";
+    const std::string location = "https://www.example.com";
+
+    EXPECT_EQ(Decode(decoder, "488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff"
+                              "6e919d29ad171863c78f0b97c8e9ae82ae43d3"),
+              (Fields{ { ":status", "302" }, { "cache-control", "private" }, { "date", date1 },
+                       { "location", location } }));
+    EXPECT_EQ(decoder.Table().Size(), 222u);
+
+    EXPECT_EQ(Decode(decoder, "4883640effc1c0bf"),
+              (Fields{ { ":status", "307" }, { "cache-control", "private" }, { "date", date1 },
+                       { "location", location } }));
+    EXPECT_EQ(decoder.Table().Size(), 222u);
+
+    EXPECT_EQ(Decode(decoder, "88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821d"
+                              "d7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007"),
+              (Fields{ { ":status", "200" }, { "cache-control", "private" }, { "date", date2 },
+                       { "location", location }, { "content-encoding", "gzip" },
+                       { "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" } }));
+    EXPECT_EQ(decoder.Table().Size(), 215u);
+    EXPECT_EQ(decoder.Table().Count(), 3u);
+}
+
+TEST(HpackTest, EncoderRoundTrip) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    const Fields fields = {
+        { ":status", "200" }, { "content-type", "text/html" }, { "content-length", "32" },
+        { "etag", "\"6ad45310-20\"" }, { "x-long", std::string(3000, 'v') },
+    };
+    size_t firstSize = 0;
+    for(int round = 0; round < 3; round++) {
+        // 第二轮前对端把表清空再恢复，编码器要先发出最小值
+        if(round == 1) {
+            encoder.SetMaxTableSize(0);
+            encoder.SetMaxTableSize(4096);
+        }
+        std::string block;
+        encoder.BeginBlock(block);
+        for(const auto &f : fields)
+            encoder.Encode(f.first, f.second, block);
+        std::vector<HeaderField> headers;
+        ASSERT_TRUE(decoder.Decode(block, headers));
+        ASSERT_EQ(headers.size(), fields.size());
+        for(size_t i = 0; i < fields.size(); i++) {
+            EXPECT_EQ(headers[i].name, fields[i].first);
+            EXPECT_EQ(headers[i].value, fields[i].second);
+        }
+        EXPECT_EQ(decoder.Table().Size(), encoder.Table().Size());
+        // 表恢复后，重复的短头部都只需要一个字节的索引
+        if(round == 0) {
+            firstSize = block.size();
+        }
+        else if(round == 2) {
+            EXPECT_LT(block.size(), firstSize);
+        }
+    }
+}
+
+TEST(HpackTest, Malformed) {
+    HpackDecoder decoder;
+    std::vector<HeaderField> headers;
+    EXPECT_FALSE(decoder.Decode(FromHex("80"), headers));           // 索引0
+    EXPECT_FALSE(decoder.Decode(FromHex("be"), headers));           // 动态表为空
+    EXPECT_FALSE(decoder.Decode(FromHex("3fe21f"), headers));       // 超过SETTINGS的表大小
+    EXPECT_FALSE(decoder.Decode(FromHex("8220"), headers));         // 大小更新不在开头
+    EXPECT_FALSE(decoder.Decode(FromHex("400a"), headers));         // 字符串被截断
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
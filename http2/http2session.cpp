@@ -0,0 +1,796 @@
+#include "http2session.h"
+#include "../http/router.h"
+
+#include <algorithm>
+
+using namespace Http2;
+
+const char Http2Session::PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+namespace {
+
+uint32_t ReadU32(const char* p) {
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+}
+
+void WriteU32(char* p, uint32_t v) {
+    p[0] = static_cast<char>(v >> 24);
+    p[1] = static_cast<char>(v >> 16);
+    p[2] = static_cast<char>(v >> 8);
+    p[3] = static_cast<char>(v);
+}
+
+// 去掉PADDED标志带来的填充长度字节和尾部填充，填充长度不合法时返回false
+bool StripPadding(uint8_t flags, const char* &payload, size_t &len) {
+    if(!(flags & FLAG_PADDED))
+        return true;
+    if(len < 1)
+        return false;
+    size_t pad = static_cast<uint8_t>(payload[0]);
+    if(pad >= len)
+        return false;
+    payload++;
+    len -= 1 + pad;
+    return true;
+}
+
+bool IsTokenChar(char c) {
+    if((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+        return true;
+    return c != '\0' && std::string_view("!#$%&'*+-.^_`|~").find(c) != std::string_view::npos;
+}
+
+// HTTP/2中禁止出现的逐跳头部，转换响应头时也要去掉
+bool IsConnectionHeader(std::string_view name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+
+// HTTP2-Settings是SETTINGS帧负载的base64url编码，不带填充
+bool DecodeBase64Url(std::string_view in, std::string &out) {
+    while(!in.empty() && in.back() == '=')
+        in.remove_suffix(1);
+    uint32_t acc = 0;
+    int bits = 0;
+    for(char c : in) {
+        int v;
+        if(c >= 'A' && c <= 'Z') v = c - 'A';
+        else if(c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if(c >= '0' && c <= '9') v = c - '0' + 52;
+        else if(c == '-') v = 62;
+        else if(c == '_') v = 63;
+        else return false;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            out.push_back(static_cast<char>(acc >> bits));
+        }
+    }
+    return out.size() % 6 == 0;
+}
+
+} // namespace
+
+Http2Session::Http2Session(const char* srcDir):
+    srcDir_(srcDir), out_(nullptr), lastStreamId_(0), pendingStream_(0), runHandlers_(true),
+    prefaceReceived_(false), settingsSent_(false), settingsReceived_(false),
+    goawayReceived_(false), closed_(false),
+    peerInitialWindow_(DEFAULT_WINDOW), peerMaxFrameSize_(DEFAULT_FRAME_SIZE),
+    sendWindow_(DEFAULT_WINDOW), recvConsumed_(0),
+    headerStream_(0), headerFlags_(0) {
+}
+
+Http2Session::~Http2Session() {
+    for(auto &it : streams_)
+        it.second->resp.ReleaseFile();
+}
+
+bool Http2Session::IsUpgradeRequest(const HttpRequest &request) {
+    if(request.version() != "HTTP/1.1" || !request.body().empty())
+        return false;
+    std::string_view upgrade = request.GetHeader("Upgrade");
+    bool h2c = false;
+    while(!upgrade.empty() && !h2c) {
+        size_t comma = upgrade.find(',');
+        std::string_view token = upgrade.substr(0, comma);
+        upgrade = comma == std::string_view::npos ? std::string_view() : upgrade.substr(comma + 1);
+        while(!token.empty() && token.front() == ' ') token.remove_prefix(1);
+        while(!token.empty() && token.back() == ' ') token.remove_suffix(1);
+        h2c = HttpRequest::EqualsIgnoreCase(token, "h2c");
+    }
+    std::string settings;
+    return h2c && DecodeBase64Url(request.GetHeader("HTTP2-Settings"), settings);
+}
+
+void Http2Session::Upgrade(const HttpRequest &request, Buffer &out) {
+    out_ = &out;
+    WriteSettings_();
+    // 101响应相当于确认了HTTP2-Settings中的设置，不需要回SETTINGS ACK
+    std::string settings;
+    DecodeBase64Url(request.GetHeader("HTTP2-Settings"), settings);
+    for(size_t i = 0; i < settings.size(); i += 6) {
+        uint16_t id = (uint8_t(settings[i]) << 8) | uint8_t(settings[i + 1]);
+        if(!ApplySetting_(id, ReadU32(&settings[i + 2])))
+            return;
+    }
+
+    Stream* stream = NewStream_(1);
+    lastStreamId_ = 1;
+    stream->remoteClosed = true;
+    Respond_(*stream, &request);
+    SendHeaders_(*stream);
+}
+
+void Http2Session::Process(Buffer &in, Buffer &out, std::vector<FileRef> &refs, size_t maxBytes,
+                           bool runHandlers) {
+    out_ = &out;
+    runHandlers_ = runHandlers;
+    if(closed_) {
+        in.RetrieveAll();
+        return;
+    }
+    // 上一批输出已经发完，发送完毕的流此时才能释放
+    Reap_();
+    if(!settingsSent_)
+        WriteSettings_();
+    // 升级时流1的DATA也等收到连接前言再发，有的客户端在101之后只准备了很小的缓冲区
+    if(!prefaceReceived_ && !ReadPreface_(in))
+        return;
+    // 上次停在等待处理函数的流上：先生成它的响应，再继续读后面的帧
+    if(pendingStream_ && runHandlers_) {
+        Stream* stream = FindStream_(pendingStream_);
+        pendingStream_ = 0;
+        if(stream)
+            Dispatch_(*stream);
+    }
+
+    while(!closed_ && !pendingStream_ && in.ReadableBytes() >= FRAME_HEADER_LEN) {
+        const uint8_t* h = reinterpret_cast<const uint8_t*>(in.Peek());
+        size_t len = (size_t(h[0]) << 16) | (size_t(h[1]) << 8) | h[2];
+        if(len > DEFAULT_FRAME_SIZE) {
+            ConnectionError_(FRAME_SIZE_ERROR, "frame too large");
+            break;
+        }
+        if(in.ReadableBytes() < FRAME_HEADER_LEN + len)
+            break;
+        uint32_t streamId = ReadU32(in.Peek() + 5) & 0x7fffffff;
+        HandleFrame_(h[3], h[4], streamId, in.Peek() + FRAME_HEADER_LEN, len);
+        in.Retrieve(FRAME_HEADER_LEN + len);
+    }
+    if(closed_) {
+        in.RetrieveAll();
+        return;
+    }
+
+    Schedule_(refs, maxBytes);
+    // 对端要求关闭时，处理完已经开始的流再关闭
+    if(goawayReceived_ && ready_.empty()) {
+        closed_ = std::all_of(streams_.begin(), streams_.end(), [](const StreamMap::value_type &it) {
+            return it.second->remoteClosed && it.second->headersSent && it.second->bodyLeft == 0;
+        });
+    }
+}
+
+bool Http2Session::ReadPreface_(Buffer &in) {
+    size_t n = std::min(in.ReadableBytes(), PREFACE_LEN);
+    if(memcmp(in.Peek(), PREFACE, n) != 0)
+        return ConnectionError_(PROTOCOL_ERROR, "bad connection preface");
+    if(n < PREFACE_LEN)
+        return false;
+    in.Retrieve(PREFACE_LEN);
+    prefaceReceived_ = true;
+    return true;
+}
+
+bool Http2Session::HandleFrame_(uint8_t type, uint8_t flags, uint32_t streamId,
+                                const char* payload, size_t len) {
+    if(headerStream_ && (type != CONTINUATION || streamId != headerStream_))
+        return ConnectionError_(PROTOCOL_ERROR, "expected CONTINUATION");
+    // 连接前言之后的第一个帧必须是SETTINGS
+    if(!settingsReceived_ && type != SETTINGS)
+        return ConnectionError_(PROTOCOL_ERROR, "expected SETTINGS");
+
+    switch(type) {
+    case DATA:
+        return OnData_(flags, streamId, payload, len);
+    case HEADERS:
+        return OnHeaders_(flags, streamId, payload, len);
+    case CONTINUATION:
+        return OnContinuation_(flags, payload, len);
+    case SETTINGS:
+        return OnSettings_(flags, streamId, payload, len);
+    case WINDOW_UPDATE:
+        return OnWindowUpdate_(streamId, payload, len);
+    case RST_STREAM:
+        return OnRstStream_(streamId, payload, len);
+    case PRIORITY:
+        // 不按优先级调度，只检查格式
+        if(streamId == 0)
+            return ConnectionError_(PROTOCOL_ERROR, "PRIORITY on stream 0");
+        if(len != 5)
+            ResetStream_(streamId, FRAME_SIZE_ERROR);
+        return true;
+    case PING:
+        if(streamId != 0)
+            return ConnectionError_(PROTOCOL_ERROR, "PING on stream");
+        if(len != 8)
+            return ConnectionError_(FRAME_SIZE_ERROR, "bad PING length");
+        if(!(flags & FLAG_ACK)) {
+            WriteFrameHeader_(8, PING, FLAG_ACK, 0);
+            out_->Append(payload, 8);
+        }
+        return true;
+    case GOAWAY:
+        if(streamId != 0)
+            return ConnectionError_(PROTOCOL_ERROR, "GOAWAY on stream");
+        if(len < 8)
+            return ConnectionError_(FRAME_SIZE_ERROR, "bad GOAWAY length");
+        goawayReceived_ = true;
+        return true;
+    case PUSH_PROMISE:
+        return ConnectionError_(PROTOCOL_ERROR, "PUSH_PROMISE from client");
+    default:
+        // 未知类型的帧直接忽略
+        return true;
+    }
+}
+
+bool Http2Session::OnData_(uint8_t flags, uint32_t streamId, const char* payload, size_t len) {
+    if(streamId == 0)
+        return ConnectionError_(PROTOCOL_ERROR, "DATA on stream 0");
+    // 流量控制按整个负载计算，包括填充
+    const int64_t frameLen = len;
+    if(frameLen > DEFAULT_WINDOW - recvConsumed_)
+        return ConnectionError_(FLOW_CONTROL_ERROR, "connection window exceeded");
+    recvConsumed_ += frameLen;
+    if(recvConsumed_ >= WINDOW_UPDATE_THRESHOLD) {
+        WriteWindowUpdate_(0, recvConsumed_);
+        recvConsumed_ = 0;
+    }
+
+    Stream* stream = FindStream_(streamId);
+    if(!stream) {
+        if(streamId > lastStreamId_)
+            return ConnectionError_(PROTOCOL_ERROR, "DATA on idle stream");
+        // 流已被重置，之后到达的帧忽略
+        return true;
+    }
+    if(stream->remoteClosed) {
+        ResetStream_(streamId, STREAM_CLOSED);
+        return true;
+    }
+    if(!StripPadding(flags, payload, len))
+        return ConnectionError_(PROTOCOL_ERROR, "bad padding");
+    if(frameLen > DEFAULT_WINDOW - stream->recvConsumed) {
+        ResetStream_(streamId, FLOW_CONTROL_ERROR);
+        return true;
+    }
+    stream->recvConsumed += frameLen;
+
+    // 请求体超长时丢弃，结束后回复400
+    if(stream->body.size() + len > HttpRequest::MAX_BODY_BYTES) {
+        stream->badRequest = true;
+        std::string().swap(stream->body);
+    }
+    if(!stream->badRequest)
+        stream->body.append(payload, len);
+
+    if(flags & FLAG_END_STREAM) {
+        stream->remoteClosed = true;
+        Dispatch_(*stream);
+    }
+    else if(stream->recvConsumed >= WINDOW_UPDATE_THRESHOLD) {
+        WriteWindowUpdate_(streamId, stream->recvConsumed);
+        stream->recvConsumed = 0;
+    }
+    return true;
+}
+
+bool Http2Session::OnHeaders_(uint8_t flags, uint32_t streamId, const char* payload, size_t len) {
+    if(streamId == 0 || streamId % 2 == 0)
+        return ConnectionError_(PROTOCOL_ERROR, "bad stream id");
+    if(!StripPadding(flags, payload, len))
+        return ConnectionError_(PROTOCOL_ERROR, "bad padding");
+    // 优先级字段：依赖的流（4字节）和权重（1字节），不使用
+    if(flags & FLAG_PRIORITY) {
+        if(len < 5)
+            return ConnectionError_(FRAME_SIZE_ERROR, "bad HEADERS length");
+        payload += 5;
+        len -= 5;
+    }
+    headerStream_ = streamId;
+    headerFlags_ = flags;
+    headerBlock_.assign(payload, len);
+    if(flags & FLAG_END_HEADERS)
+        return OnHeaderBlock_();
+    return true;
+}
+
+bool Http2Session::OnContinuation_(uint8_t flags, const char* payload, size_t len) {
+    if(headerStream_ == 0)
+        return ConnectionError_(PROTOCOL_ERROR, "unexpected CONTINUATION");
+    if(headerBlock_.size() + len > MAX_HEADER_BLOCK)
+        return ConnectionError_(ENHANCE_YOUR_CALM, "header block too large");
+    headerBlock_.append(payload, len);
+    if(flags & FLAG_END_HEADERS)
+        return OnHeaderBlock_();
+    return true;
+}
+
+bool Http2Session::OnHeaderBlock_() {
+    const uint32_t streamId = headerStream_;
+    const uint8_t flags = headerFlags_;
+    headerStream_ = 0;
+
+    // 无论流是否被接受都要解码，保持与对端编码器的动态表同步
+    std::vector<HeaderField> headers;
+    if(!decoder_.Decode(headerBlock_, headers))
+        return ConnectionError_(COMPRESSION_ERROR, "bad header block");
+
+    Stream* stream = FindStream_(streamId);
+    if(stream) {
+        // 请求体之后的尾部头块（trailers）必须结束流，内容不使用
+        if(stream->remoteClosed) {
+            ResetStream_(streamId, STREAM_CLOSED);
+        }
+        else if(!(flags & FLAG_END_STREAM)) {
+            ResetStream_(streamId, PROTOCOL_ERROR);
+        }
+        else {
+            stream->remoteClosed = true;
+            Dispatch_(*stream);
+        }
+        return true;
+    }
+    if(streamId <= lastStreamId_)
+        return ConnectionError_(STREAM_CLOSED, "HEADERS on closed stream");
+    lastStreamId_ = streamId;
+    if(streams_.size() >= MAX_STREAMS) {
+        ResetStream_(streamId, REFUSED_STREAM);
+        return true;
+    }
+
+    stream = NewStream_(streamId);
+    stream->headers.swap(headers);
+    if(!ValidateHeaders_(*stream)) {
+        ResetStream_(streamId, PROTOCOL_ERROR);
+        return true;
+    }
+    if(flags & FLAG_END_STREAM) {
+        stream->remoteClosed = true;
+        Dispatch_(*stream);
+    }
+    return true;
+}
+
+bool Http2Session::OnSettings_(uint8_t flags, uint32_t streamId, const char* payload, size_t len) {
+    if(streamId != 0)
+        return ConnectionError_(PROTOCOL_ERROR, "SETTINGS on stream");
+    if(flags & FLAG_ACK) {
+        if(len != 0)
+            return ConnectionError_(FRAME_SIZE_ERROR, "SETTINGS ACK with payload");
+        return true;
+    }
+    if(len % 6 != 0)
+        return ConnectionError_(FRAME_SIZE_ERROR, "bad SETTINGS length");
+    for(size_t i = 0; i < len; i += 6) {
+        uint16_t id = (uint8_t(payload[i]) << 8) | uint8_t(payload[i + 1]);
+        if(!ApplySetting_(id, ReadU32(payload + i + 2)))
+            return false;
+    }
+    settingsReceived_ = true;
+    WriteFrameHeader_(0, SETTINGS, FLAG_ACK, 0);
+    return true;
+}
+
+bool Http2Session::ApplySetting_(uint16_t id, uint32_t value) {
+    switch(id) {
+    case HEADER_TABLE_SIZE:
+        encoder_.SetMaxTableSize(value);
+        break;
+    case ENABLE_PUSH:
+        if(value > 1)
+            return ConnectionError_(PROTOCOL_ERROR, "bad ENABLE_PUSH");
+        break;
+    case INITIAL_WINDOW_SIZE: {
+        if(value > MAX_WINDOW)
+            return ConnectionError_(FLOW_CONTROL_ERROR, "bad INITIAL_WINDOW_SIZE");
+        // 已打开的流按差值调整发送窗口，可能变为负数
+        const int64_t delta = int64_t(value) - peerInitialWindow_;
+        peerInitialWindow_ = value;
+        for(auto &it : streams_) {
+            Stream &stream = *it.second;
+            stream.sendWindow += delta;
+            if(stream.sendWindow > MAX_WINDOW)
+                return ConnectionError_(FLOW_CONTROL_ERROR, "stream window overflow");
+            Queue_(stream);
+        }
+        break;
+    }
+    case MAX_FRAME_SIZE:
+        if(value < DEFAULT_FRAME_SIZE || value > MAX_FRAME_SIZE_LIMIT)
+            return ConnectionError_(PROTOCOL_ERROR, "bad MAX_FRAME_SIZE");
+        peerMaxFrameSize_ = value;
+        break;
+    default:
+        // MAX_CONCURRENT_STREAMS只限制服务器推送，MAX_HEADER_LIST_SIZE是建议值，未知设置忽略
+        break;
+    }
+    return true;
+}
+
+bool Http2Session::OnWindowUpdate_(uint32_t streamId, const char* payload, size_t len) {
+    if(len != 4)
+        return ConnectionError_(FRAME_SIZE_ERROR, "bad WINDOW_UPDATE length");
+    const int64_t increment = ReadU32(payload) & 0x7fffffff;
+    if(streamId == 0) {
+        if(increment == 0)
+            return ConnectionError_(PROTOCOL_ERROR, "zero window increment");
+        sendWindow_ += increment;
+        if(sendWindow_ > MAX_WINDOW)
+            return ConnectionError_(FLOW_CONTROL_ERROR, "connection window overflow");
+        return true;
+    }
+    Stream* stream = FindStream_(streamId);
+    if(!stream) {
+        if(streamId > lastStreamId_)
+            return ConnectionError_(PROTOCOL_ERROR, "WINDOW_UPDATE on idle stream");
+        return true;
+    }
+    if(increment == 0) {
+        ResetStream_(streamId, PROTOCOL_ERROR);
+        return true;
+    }
+    stream->sendWindow += increment;
+    if(stream->sendWindow > MAX_WINDOW) {
+        ResetStream_(streamId, FLOW_CONTROL_ERROR);
+        return true;
+    }
+    Queue_(*stream);
+    return true;
+}
+
+bool Http2Session::OnRstStream_(uint32_t streamId, const char* payload, size_t len) {
+    if(len != 4)
+        return ConnectionError_(FRAME_SIZE_ERROR, "bad RST_STREAM length");
+    if(streamId == 0 || streamId > lastStreamId_)
+        return ConnectionError_(PROTOCOL_ERROR, "RST_STREAM on idle stream");
+    auto it = streams_.find(streamId);
+    if(it != streams_.end()) {
+        LOG_DEBUG("h2 stream %u reset by peer, error:%u", streamId, ReadU32(payload));
+        CloseStream_(it);
+    }
+    return true;
+}
+
+// 发送GOAWAY后不再处理任何帧，输出发完后关闭连接
+bool Http2Session::ConnectionError_(ErrorCode code, const char* reason) {
+    LOG_WARN("h2 connection error %u: %s", code, reason);
+    char payload[8];
+    WriteU32(payload, lastStreamId_);
+    WriteU32(payload + 4, code);
+    WriteFrameHeader_(sizeof(payload), GOAWAY, 0, 0);
+    out_->Append(payload, sizeof(payload));
+    headerStream_ = 0;
+    closed_ = true;
+    return false;
+}
+
+void Http2Session::ResetStream_(uint32_t streamId, ErrorCode code) {
+    LOG_DEBUG("h2 reset stream %u, error:%u", streamId, code);
+    char payload[4];
+    WriteU32(payload, code);
+    WriteFrameHeader_(sizeof(payload), RST_STREAM, 0, streamId);
+    out_->Append(payload, sizeof(payload));
+    auto it = streams_.find(streamId);
+    if(it != streams_.end())
+        CloseStream_(it);
+}
+
+Http2Session::Stream* Http2Session::FindStream_(uint32_t streamId) {
+    auto it = streams_.find(streamId);
+    return it == streams_.end() ? nullptr : it->second.get();
+}
+
+Http2Session::Stream* Http2Session::NewStream_(uint32_t streamId) {
+    std::unique_ptr<Stream> stream;
+    if(freeStreams_.empty()) {
+        stream.reset(new Stream());
+    }
+    else {
+        stream = std::move(freeStreams_.back());
+        freeStreams_.pop_back();
+    }
+    stream->id = streamId;
+    stream->remoteClosed = false;
+    stream->badRequest = false;
+    stream->isHead = false;
+    stream->headersSent = false;
+    stream->queued = false;
+    stream->sendWindow = peerInitialWindow_;
+    stream->recvConsumed = 0;
+    stream->contentLength = -1;
+    stream->headerLen = stream->bodyPos = 0;
+    stream->sliceIdx = stream->sliceOff = 0;
+    stream->bodyLeft = 0;
+    Stream* ptr = stream.get();
+    streams_[streamId] = std::move(stream);
+    return ptr;
+}
+
+Http2Session::StreamMap::iterator Http2Session::CloseStream_(StreamMap::iterator it) {
+    Stream* stream = it->second.get();
+    if(stream->queued)
+        ready_.erase(std::find(ready_.begin(), ready_.end(), stream));
+    stream->resp.ReleaseFile();
+    stream->out.ReleaseStorage();        // 复用的流对象不占着输出缓冲区
+    stream->headers.clear();
+    stream->body.clear();
+    freeStreams_.push_back(std::move(it->second));
+    return streams_.erase(it);
+}
+
+void Http2Session::Reap_() {
+    for(auto it = streams_.begin(); it != streams_.end(); ) {
+        const Stream &stream = *it->second;
+        if(stream.remoteClosed && stream.headersSent && stream.bodyLeft == 0)
+            it = CloseStream_(it);
+        else
+            ++it;
+    }
+}
+
+void Http2Session::Queue_(Stream &stream) {
+    if(!stream.queued && stream.headersSent && stream.bodyLeft > 0 && stream.sendWindow > 0) {
+        ready_.push_back(&stream);
+        stream.queued = true;
+    }
+}
+
+// 请求头必须是合法的HTTP/2请求：伪头部在前且只有请求伪头部，名字为小写token，
+// 没有逐跳头部，值中没有NUL/CR/LF（否则转换成HTTP/1.1文本时会被注入额外的头部）
+bool Http2Session::ValidateHeaders_(Stream &stream) const {
+    enum { METHOD = 1, SCHEME = 2, PATH = 4, AUTHORITY = 8 };
+    int seen = 0;
+    bool regular = false;
+    for(const HeaderField &h : stream.headers) {
+        if(h.name.empty() || h.value.find_first_of(std::string_view("\0\r\n", 3)) != std::string::npos)
+            return false;
+        if(h.name[0] == ':') {
+            int bit = h.name == ":method" ? METHOD : h.name == ":scheme" ? SCHEME :
+                      h.name == ":path" ? PATH : h.name == ":authority" ? AUTHORITY : 0;
+            if(regular || bit == 0 || (seen & bit))
+                return false;
+            if(bit == PATH && h.value.empty())
+                return false;
+            seen |= bit;
+            continue;
+        }
+        regular = true;
+        for(char c : h.name) {
+            if(!IsTokenChar(c) || (c >= 'A' && c <= 'Z'))
+                return false;
+        }
+        if(IsConnectionHeader(h.name) || (h.name == "te" && h.value != "trailers"))
+            return false;
+        if(h.name == "content-length") {
+            if(h.value.empty() || h.value.size() > 18 ||
+               h.value.find_first_not_of("0123456789") != std::string::npos)
+                return false;
+            stream.contentLength = std::stoll(h.value);
+        }
+    }
+    return (seen & (METHOD | SCHEME | PATH)) == (METHOD | SCHEME | PATH);
+}
+
+/*
+    请求转换成HTTP/1.1文本交给HttpRequest解析：:authority变为Host，
+    多个cookie头按"; "合并，请求体的长度以实际收到的为准
+*/
+void Http2Session::Dispatch_(Stream &stream) {
+    if(!stream.badRequest && stream.contentLength >= 0 &&
+       stream.contentLength != static_cast<int64_t>(stream.body.size())) {
+        ResetStream_(stream.id, PROTOCOL_ERROR);
+        return;
+    }
+    const HttpRequest* request = nullptr;
+    if(!stream.badRequest) {
+        std::string_view method, path, authority;
+        for(const HeaderField &h : stream.headers) {
+            if(h.name == ":method") method = h.value;
+            else if(h.name == ":path") path = h.value;
+            else if(h.name == ":authority") authority = h.value;
+        }
+        // 处理函数可能阻塞，不在事件循环中调用，流的请求头和请求体留到下次Process
+        if(!runHandlers_ && HttpRouter::Find(method, path)) {
+            pendingStream_ = stream.id;
+            return;
+        }
+        reqBuff_.RetrieveAll();
+        reqBuff_.Append({ method, " ", path, " HTTP/1.1\r\n" });
+        if(!authority.empty())
+            reqBuff_.Append({ "Host: ", authority, "\r\n" });
+        std::string cookie;
+        for(const HeaderField &h : stream.headers) {
+            if(h.name[0] == ':' || h.name == "content-length" || (h.name == "host" && !authority.empty()))
+                continue;
+            if(h.name == "cookie") {
+                cookie += cookie.empty() ? "" : "; ";
+                cookie += h.value;
+                continue;
+            }
+            reqBuff_.Append({ h.name, ": ", h.value, "\r\n" });
+        }
+        if(!cookie.empty())
+            reqBuff_.Append({ "cookie: ", cookie, "\r\n" });
+        if(!stream.body.empty())
+            reqBuff_.Append("Content-length: " + std::to_string(stream.body.size()) + "\r\n");
+        reqBuff_.Append({ "\r\n", stream.body });
+
+        request_.Init();
+        if(request_.parse(reqBuff_) == HttpRequest::PARSE_OK)
+            request = &request_;
+    }
+    Respond_(stream, request);
+    SendHeaders_(stream);
+    stream.headers.clear();
+    stream.body.clear();
+}
+
+// 响应由HttpResponse按HTTP/1.1生成，响应头部分之后再转换
+void Http2Session::Respond_(Stream &stream, const HttpRequest* request) {
+    stream.out.RetrieveAll();
+    if(request) {
+        LOG_DEBUG("h2 stream %u: %.*s", stream.id, (int)request->path().size(), request->path().data());
+        stream.isHead = request->method() == "HEAD";
+        stream.resp.Init(srcDir_, request->path(), true, 200);
+        stream.resp.MakeResponse(stream.out, request);
+        // 流式响应的响应体由FillStream产生，这里的DATA帧只能发送长度已知的响应
+        if(stream.resp.IsStreaming()) {
+            LOG_ERROR("h2 stream %u: streaming response not supported", stream.id);
+            stream.out.RetrieveAll();
+            stream.resp.Init(srcDir_, request->path(), true, 500);
+            stream.resp.MakeErrorResponse(stream.out, 500, "Streaming response not supported over HTTP/2");
+        }
+    }
+    else {
+        stream.resp.Init(srcDir_, "", false, 400);
+        stream.resp.MakeResponse(stream.out);
+    }
+
+    std::string_view text(stream.out.Peek(), stream.out.ReadableBytes());
+    stream.headerLen = text.find("\r\n\r\n") + 4;
+    stream.bodyPos = stream.headerLen;
+    stream.sliceIdx = stream.sliceOff = 0;
+    stream.bodyLeft = 0;
+    if(stream.isHead) {
+        stream.resp.ReleaseFile();
+        return;
+    }
+    stream.bodyLeft = text.size() - stream.headerLen;
+    for(const HttpResponse::FileSlice &slice : stream.resp.Slices())
+        stream.bodyLeft += slice.len;
+}
+
+// 状态行变为:status，其余头部名字转成小写，去掉逐跳头部；头块超过对端帧大小时分成CONTINUATION
+void Http2Session::SendHeaders_(Stream &stream) {
+    std::string_view text(stream.out.Peek(), stream.headerLen - 2);
+    size_t lineEnd = text.find("\r\n");
+    std::string block;
+    encoder_.BeginBlock(block);
+    encoder_.Encode(":status", text.substr(9, 3), block);
+
+    std::string name;
+    for(size_t pos = lineEnd + 2; pos < text.size(); pos = lineEnd + 2) {
+        lineEnd = text.find("\r\n", pos);
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        size_t colon = line.find(':');
+        name.assign(line.data(), colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if(IsConnectionHeader(name))
+            continue;
+        std::string_view value = line.substr(colon + 1);
+        while(!value.empty() && value.front() == ' ')
+            value.remove_prefix(1);
+        encoder_.Encode(name, value, block);
+    }
+
+    size_t pos = 0;
+    do {
+        size_t len = std::min(block.size() - pos, peerMaxFrameSize_);
+        uint8_t flags = pos + len == block.size() ? FLAG_END_HEADERS : 0;
+        if(pos == 0 && stream.bodyLeft == 0)
+            flags |= FLAG_END_STREAM;
+        WriteFrameHeader_(len, pos == 0 ? HEADERS : CONTINUATION, flags, stream.id);
+        out_->Append(block.data() + pos, len);
+        pos += len;
+    } while(pos < block.size());
+
+    stream.headersSent = true;
+    Queue_(stream);
+}
+
+// 一个DATA帧：帧头和内嵌的响应体片段拷贝到输出缓冲区，文件内容只记录位置
+void Http2Session::SendData_(Stream &stream, size_t len, std::vector<FileRef> &refs) {
+    const uint8_t flags = len == stream.bodyLeft ? FLAG_END_STREAM : 0;
+    WriteFrameHeader_(len, DATA, flags, stream.id);
+    const std::vector<HttpResponse::FileSlice> &slices = stream.resp.Slices();
+    for(size_t left = len; left > 0; ) {
+        if(stream.sliceIdx < slices.size() && stream.bodyPos == slices[stream.sliceIdx].bufEnd) {
+            const HttpResponse::FileSlice &slice = slices[stream.sliceIdx];
+            size_t n = std::min(left, slice.len - stream.sliceOff);
+            refs.push_back({ out_->ReadableBytes(), &stream.resp, slice.offset + stream.sliceOff, n });
+            stream.sliceOff += n;
+            left -= n;
+            if(stream.sliceOff == slice.len) {
+                stream.sliceIdx++;
+                stream.sliceOff = 0;
+            }
+        }
+        else {
+            size_t end = stream.sliceIdx < slices.size() ? slices[stream.sliceIdx].bufEnd
+                                                         : stream.out.ReadableBytes();
+            size_t n = std::min(left, end - stream.bodyPos);
+            out_->Append(stream.out.Peek() + stream.bodyPos, n);
+            stream.bodyPos += n;
+            left -= n;
+        }
+    }
+    stream.bodyLeft -= len;
+    stream.sendWindow -= len;
+    sendWindow_ -= len;
+}
+
+// 各流轮流发送一个DATA帧，流窗口用完的流移出队列，WINDOW_UPDATE到达后再加入
+void Http2Session::Schedule_(std::vector<FileRef> &refs, size_t maxBytes) {
+    size_t written = out_->ReadableBytes();
+    while(!ready_.empty() && sendWindow_ > 0 && written < maxBytes) {
+        Stream* stream = ready_.front();
+        ready_.pop_front();
+        stream->queued = false;
+        // SETTINGS可能在流排队后把窗口调小甚至变为负数
+        if(stream->sendWindow <= 0)
+            continue;
+        size_t len = std::min<int64_t>({ static_cast<int64_t>(stream->bodyLeft), stream->sendWindow,
+                                         sendWindow_, static_cast<int64_t>(peerMaxFrameSize_) });
+        SendData_(*stream, len, refs);
+        written += FRAME_HEADER_LEN + len;
+        Queue_(*stream);
+    }
+}
+
+void Http2Session::WriteFrameHeader_(size_t len, uint8_t type, uint8_t flags, uint32_t streamId) {
+    char header[FRAME_HEADER_LEN];
+    header[0] = static_cast<char>(len >> 16);
+    header[1] = static_cast<char>(len >> 8);
+    header[2] = static_cast<char>(len);
+    header[3] = static_cast<char>(type);
+    header[4] = static_cast<char>(flags);
+    WriteU32(header + 5, streamId & 0x7fffffff);
+    out_->Append(header, sizeof(header));
+}
+
+void Http2Session::WriteSettings_() {
+    const std::pair<uint16_t, uint32_t> settings[] = {
+        { MAX_CONCURRENT_STREAMS, MAX_STREAMS },
+        { MAX_HEADER_LIST_SIZE, MAX_HEADER_LIST },
+    };
+    WriteFrameHeader_(sizeof(settings) / sizeof(settings[0]) * 6, SETTINGS, 0, 0);
+    for(const auto &s : settings) {
+        char entry[6];
+        entry[0] = static_cast<char>(s.first >> 8);
+        entry[1] = static_cast<char>(s.first);
+        WriteU32(entry + 2, s.second);
+        out_->Append(entry, sizeof(entry));
+    }
+    settingsSent_ = true;
+}
+
+void Http2Session::WriteWindowUpdate_(uint32_t streamId, uint32_t increment) {
+    char payload[4];
+    WriteU32(payload, increment);
+    WriteFrameHeader_(sizeof(payload), WINDOW_UPDATE, 0, streamId);
+    out_->Append(payload, sizeof(payload));
+}
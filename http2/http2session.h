@@ -0,0 +1,200 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "../log/log.h"
+#include "../buffer/buffer.h"
+#include "../http/httprequest.h"
+#include "../http/httpresponse.h"
+#include "hpack.h"
+
+/*
+    HTTP/2明文连接（h2c，RFC 7540）：
+    - 通过连接前言（prior knowledge）或HTTP/1.1的Upgrade: h2c进入；
+    - 一个连接上的多个流并发处理，每个流的请求头解码后转成HTTP/1.1请求交给HttpRequest解析，
+      响应仍由HttpResponse生成（共享FileCache、gzip变体、Range、304等逻辑），
+      再把响应头转成HPACK头块，响应体切成DATA帧；
+    - 文件内容不拷贝，DATA帧的帧头写入输出缓冲区，负载以FileRef的形式交给HttpConn组装iovec；
+    - 发送受连接级和流级流量控制窗口限制，多个流的DATA帧轮转调度，
+      每批输出不超过maxBytes，其余的等这一批发完后下次Process时继续。
+    会话对象只在所属连接的线程中使用，不加锁。
+*/
+
+namespace Http2 {
+
+const size_t FRAME_HEADER_LEN = 9;
+const size_t DEFAULT_FRAME_SIZE = 16384;
+const size_t MAX_FRAME_SIZE_LIMIT = (1 << 24) - 1;
+const int64_t DEFAULT_WINDOW = 65535;
+const int64_t MAX_WINDOW = 0x7fffffff;
+
+enum FrameType : uint8_t {
+    DATA = 0x0,
+    HEADERS = 0x1,
+    PRIORITY = 0x2,
+    RST_STREAM = 0x3,
+    SETTINGS = 0x4,
+    PUSH_PROMISE = 0x5,
+    PING = 0x6,
+    GOAWAY = 0x7,
+    WINDOW_UPDATE = 0x8,
+    CONTINUATION = 0x9,
+};
+
+enum Flag : uint8_t {
+    FLAG_END_STREAM = 0x1,
+    FLAG_ACK = 0x1,
+    FLAG_END_HEADERS = 0x4,
+    FLAG_PADDED = 0x8,
+    FLAG_PRIORITY = 0x20,
+};
+
+enum Setting : uint16_t {
+    HEADER_TABLE_SIZE = 0x1,
+    ENABLE_PUSH = 0x2,
+    MAX_CONCURRENT_STREAMS = 0x3,
+    INITIAL_WINDOW_SIZE = 0x4,
+    MAX_FRAME_SIZE = 0x5,
+    MAX_HEADER_LIST_SIZE = 0x6,
+};
+
+enum ErrorCode : uint32_t {
+    NO_ERROR = 0x0,
+    PROTOCOL_ERROR = 0x1,
+    INTERNAL_ERROR = 0x2,
+    FLOW_CONTROL_ERROR = 0x3,
+    SETTINGS_TIMEOUT = 0x4,
+    STREAM_CLOSED = 0x5,
+    FRAME_SIZE_ERROR = 0x6,
+    REFUSED_STREAM = 0x7,
+    CANCEL = 0x8,
+    COMPRESSION_ERROR = 0x9,
+    CONNECT_ERROR = 0xa,
+    ENHANCE_YOUR_CALM = 0xb,
+};
+
+} // namespace Http2
+
+class Http2Session {
+public:
+    explicit Http2Session(const char* srcDir);
+    ~Http2Session();
+
+    Http2Session(const Http2Session&) = delete;
+    Http2Session& operator=(const Http2Session&) = delete;
+
+    // GET/HEAD等不带请求体的HTTP/1.1请求，Upgrade中有h2c且带合法的HTTP2-Settings
+    static bool IsUpgradeRequest(const HttpRequest &request);
+    // 升级后请求成为流1（对端已半关闭），响应在后续Process中以HTTP/2发送；
+    // 调用前101响应已写入out，需在请求数据从缓冲区取走之前调用
+    void Upgrade(const HttpRequest &request, Buffer &out);
+
+    // 处理in中所有完整的帧并取走，把要发送的帧追加到out，文件内容追加到refs；
+    // 上一批输出发送完之后才能再次调用。runHandlers为false时遇到要交给处理函数的请求就停下，
+    // 后面的帧留在in中，HandlerPending()为true，之后以runHandlers为true调用时先补上它的响应
+    void Process(Buffer &in, Buffer &out, std::vector<FileRef> &refs, size_t maxBytes,
+                 bool runHandlers = true);
+    bool HandlerPending() const { return pendingStream_ != 0; }
+
+    // 已发出GOAWAY，或对端发来GOAWAY且所有流都已结束，输出发完后应关闭连接
+    bool IsClosed() const { return closed_; }
+
+    static const char PREFACE[];
+    static constexpr size_t PREFACE_LEN = 24;
+    static constexpr uint32_t MAX_STREAMS = 128;                // 本端的SETTINGS_MAX_CONCURRENT_STREAMS
+    static constexpr size_t MAX_HEADER_LIST = HttpRequest::MAX_HEADER_BYTES;
+    static constexpr size_t MAX_HEADER_BLOCK = 64 * 1024;       // 跨CONTINUATION累积的头块上限
+    static constexpr int64_t WINDOW_UPDATE_THRESHOLD = Http2::DEFAULT_WINDOW / 2;  // 接收窗口用掉一半时归还
+
+private:
+    struct Stream {
+        uint32_t id;
+        bool remoteClosed;          // 对端已发送END_STREAM
+        bool badRequest;            // 请求头不合法或请求体超长，回复400
+        bool isHead;
+        bool headersSent;
+        bool queued;                // 在ready_中
+        int64_t sendWindow;
+        int64_t recvConsumed;       // 已收到但还没有用WINDOW_UPDATE归还的字节
+        std::vector<HeaderField> headers;
+        std::string body;
+        int64_t contentLength;      // 请求中的content-length，没有时为-1
+
+        // 响应：out中是HTTP/1.1格式的响应头和内嵌的响应体片段，文件内容在resp的Slices中
+        HttpResponse resp;
+        Buffer out;
+        size_t headerLen;
+        size_t bodyPos;             // out中下一个未发送的响应体字节
+        size_t sliceIdx;
+        size_t sliceOff;            // 当前文件片段中已发送的字节
+        size_t bodyLeft;
+    };
+    typedef std::unordered_map<uint32_t, std::unique_ptr<Stream>> StreamMap;
+
+    bool ReadPreface_(Buffer &in);
+    bool HandleFrame_(uint8_t type, uint8_t flags, uint32_t streamId, const char* payload, size_t len);
+    bool OnData_(uint8_t flags, uint32_t streamId, const char* payload, size_t len);
+    bool OnHeaders_(uint8_t flags, uint32_t streamId, const char* payload, size_t len);
+    bool OnContinuation_(uint8_t flags, const char* payload, size_t len);
+    bool OnHeaderBlock_();
+    bool OnSettings_(uint8_t flags, uint32_t streamId, const char* payload, size_t len);
+    bool ApplySetting_(uint16_t id, uint32_t value);
+    bool OnWindowUpdate_(uint32_t streamId, const char* payload, size_t len);
+    bool OnRstStream_(uint32_t streamId, const char* payload, size_t len);
+    bool ConnectionError_(Http2::ErrorCode code, const char* reason);
+    void ResetStream_(uint32_t streamId, Http2::ErrorCode code);
+
+    Stream* FindStream_(uint32_t streamId);
+    Stream* NewStream_(uint32_t streamId);
+    StreamMap::iterator CloseStream_(StreamMap::iterator it);
+    void Queue_(Stream &stream);
+    bool ValidateHeaders_(Stream &stream) const;
+    void Respond_(Stream &stream, const HttpRequest* request);
+    void Dispatch_(Stream &stream);
+    void SendHeaders_(Stream &stream);
+    void SendData_(Stream &stream, size_t len, std::vector<FileRef> &refs);
+    void Schedule_(std::vector<FileRef> &refs, size_t maxBytes);
+    void Reap_();
+
+    void WriteFrameHeader_(size_t len, uint8_t type, uint8_t flags, uint32_t streamId);
+    void WriteSettings_();
+    void WriteWindowUpdate_(uint32_t streamId, uint32_t increment);
+
+    std::string srcDir_;
+    Buffer* out_;                   // 本次Process的输出缓冲区
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    HttpRequest request_;
+    Buffer reqBuff_;                // 转换成HTTP/1.1格式的请求
+
+    StreamMap streams_;
+    std::vector<std::unique_ptr<Stream>> freeStreams_;   // 已结束的流，连同缓冲区复用
+    std::deque<Stream*> ready_;     // 有响应体待发送的流，按轮转顺序
+    uint32_t lastStreamId_;         // 对端打开过的最大流ID
+    uint32_t pendingStream_;        // 等待处理函数的流，为0时没有
+    bool runHandlers_;              // 本次Process能否调用处理函数
+
+    bool prefaceReceived_;
+    bool settingsSent_;
+    bool settingsReceived_;
+    bool goawayReceived_;
+    bool closed_;
+
+    // 对端的设置
+    int64_t peerInitialWindow_;
+    size_t peerMaxFrameSize_;
+
+    int64_t sendWindow_;            // 连接级发送窗口
+    int64_t recvConsumed_;
+
+    // 正在接收的头块，收到END_HEADERS之前只能出现同一个流的CONTINUATION
+    uint32_t headerStream_;
+    uint8_t headerFlags_;
+    std::string headerBlock_;
+};
@@ -129,7 +129,8 @@ void Log::write(int level, const char* format, ...) {
     {
         unique_lock<mutex> locker(mtx_);
         lineCount_++;
-        // 将格式化字符串输出到缓冲区
+        // 将格式化字符串输出到缓冲区，缓冲区在第一次写入时才分配空间
+        buff_.EnsureWriteable(128);
         int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
                     t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
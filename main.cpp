@@ -1,12 +1,44 @@
 #include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
 #include "server/webserver.h"
 
-int main()
+static void Usage(const char* prog) {
+    std::cerr << "usage: " << prog << " [-p port] [-s subReactorNum] [-r] [-b backlog] [-u]\n"
+              << "  -p  监听端口，默认1316\n"
+              << "  -s  从Reactor数量，0为单Reactor模式（默认）\n"
+              << "  -r  从Reactor各自用SO_REUSEPORT监听，需配合-s\n"
+              << "  -b  listen backlog，默认SOMAXCONN\n"
+              << "  -u  使用io_uring后端\n";
+}
+
+int main(int argc, char* argv[])
 {
+    int port = 1316;
+    int subReactorNum = 0;
+    bool reusePort = false;
+    int backlog = SOMAXCONN;
+    bool ioUring = false;
+
+    int opt;
+    while((opt = getopt(argc, argv, "p:s:rb:uh")) != -1) {
+        switch(opt) {
+        case 'p': port = atoi(optarg); break;
+        case 's': subReactorNum = atoi(optarg); break;
+        case 'r': reusePort = true; break;
+        case 'b': backlog = atoi(optarg); break;
+        case 'u': ioUring = true; break;
+        default:
+            Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
     WebServer server(
-        1316, 3, 60000, false,
+        port, 3, 60000, false,
         3306, "root", "qihang123", "webserver",
-        12, 6, true, 1, 1024
+        12, 6, true, 1, 1024,
+        subReactorNum, reusePort, backlog, ioUring
     );
     server.Start();
-}
\ No newline at end of file
+}
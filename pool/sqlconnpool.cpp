@@ -29,16 +29,31 @@ void SqlConnPool::Init(const char* host, int port,
         {
             assert(sql);
         }
+        // 查询在事件循环线程中执行，数据库无响应时最多阻塞这么久
+        unsigned int timeout = QUERY_TIMEOUT_SEC;
+        mysql_options(sql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+        mysql_options(sql, MYSQL_OPT_READ_TIMEOUT, &timeout);
+        mysql_options(sql, MYSQL_OPT_WRITE_TIMEOUT, &timeout);
+        // 连不上数据库时照常提供静态文件，依赖数据库的接口拿不到连接
+        if(!mysql_real_connect(sql, host, user, pwd, dbName, port, nullptr, 0))
+        {
+            LOG_ERROR("MySql Connect error: %s", mysql_error(sql));
+            mysql_close(sql);
+            break;
+        }
+        connQue_.push(sql);
     }
+    MAX_CONN_ = connQue_.size();
+    sem_init(&semId_, 0, MAX_CONN_);
 }
 
+// 不等待：处理函数运行在事件循环线程中，连接都被占用时立即返回nullptr，由调用者回复503
 MYSQL* SqlConnPool::GetConn() {
     MYSQL *sql = nullptr;
-    if(connQue_.empty()) {
+    if(sem_trywait(&semId_) != 0) {
         LOG_WARN("SqlConnPool busy!");
         return nullptr;
     }
-    sem_wait(&semId_);
     {
         std::lock_guard<std::mutex> locker(mtx_);
         sql = connQue_.front();
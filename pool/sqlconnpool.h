@@ -11,7 +11,7 @@
 class SqlConnPool {
 public:
     static SqlConnPool *Instance();
-    MYSQL* GetConn();
+    MYSQL* GetConn();           // 没有空闲连接时不等待，返回nullptr
     void FreeConn(MYSQL* conn);
     int GetFreeCount();
 
@@ -20,6 +20,8 @@ public:
             const char* dbName, int connSize);
     void ClosePool();
 
+    static const unsigned int QUERY_TIMEOUT_SEC = 3;
+
 private:
     SqlConnPool();
     ~SqlConnPool();
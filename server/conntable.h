@@ -0,0 +1,97 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+#include <assert.h>
+
+/*
+    以fd为下标的连接表，代替unordered_map<int, HttpConn>：
+    - 槽位一次性按capacity分配，连续存放，查找就是一次数组下标，没有哈希和rehash停顿；
+    - T在该fd第一次被使用时才构造，之后随fd复用，未用到的页不会占用物理内存；
+    - 每个槽带一个代数，Open和Release时各加一，持有(fd, gen)的异步任务可据此判断连接是否已失效。
+    不同fd的槽可以被不同线程并发使用，同一个槽的Open/Release须由持有它的Reactor线程调用。
+*/
+
+template<class T>
+class ConnTable {
+public:
+    explicit ConnTable(int capacity);
+    ~ConnTable();
+
+    ConnTable(const ConnTable&) = delete;
+    ConnTable& operator=(const ConnTable&) = delete;
+
+    int Capacity() const { return capacity_; }
+    bool Contains(int fd) const { return fd >= 0 && fd < capacity_; }
+
+    // 新连接占用fd对应的槽，返回槽
+    T* Open(int fd);
+    // 连接关闭，使之前取得的代数失效
+    void Release(int fd);
+
+    T* Get(int fd);
+    uint32_t Generation(int fd) const;
+    bool IsCurrent(int fd, uint32_t gen) const;
+
+private:
+    int capacity_;
+    T* slots_;
+    std::unique_ptr<bool[]> inited_;
+    std::unique_ptr<std::atomic<uint32_t>[]> gens_;
+};
+
+template<class T>
+ConnTable<T>::ConnTable(int capacity): capacity_(capacity),
+        slots_(static_cast<T*>(::operator new(sizeof(T) * capacity))),
+        inited_(new bool[capacity]()), gens_(new std::atomic<uint32_t>[capacity])
+{
+    assert(capacity > 0);
+    for(int i=0; i<capacity; i++) {
+        gens_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+ConnTable<T>::~ConnTable() {
+    for(int i=0; i<capacity_; i++) {
+        if(inited_[i])
+            slots_[i].~T();
+    }
+    ::operator delete(slots_);
+}
+
+template<class T>
+T* ConnTable<T>::Open(int fd) {
+    assert(Contains(fd));
+    if(!inited_[fd]) {
+        new (&slots_[fd]) T();
+        inited_[fd] = true;
+    }
+    gens_[fd].fetch_add(1, std::memory_order_release);
+    return &slots_[fd];
+}
+
+template<class T>
+void ConnTable<T>::Release(int fd) {
+    assert(Contains(fd));
+    gens_[fd].fetch_add(1, std::memory_order_release);
+}
+
+template<class T>
+T* ConnTable<T>::Get(int fd) {
+    assert(Contains(fd) && inited_[fd]);
+    return &slots_[fd];
+}
+
+template<class T>
+uint32_t ConnTable<T>::Generation(int fd) const {
+    assert(Contains(fd));
+    return gens_[fd].load(std::memory_order_acquire);
+}
+
+template<class T>
+bool ConnTable<T>::IsCurrent(int fd, uint32_t gen) const {
+    return Contains(fd) && gens_[fd].load(std::memory_order_acquire) == gen;
+}
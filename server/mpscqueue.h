@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <assert.h>
+
+/*
+    有界无锁多生产者单消费者队列（Vyukov bounded queue）：
+    每个槽带一个序号，生产者用CAS抢占写位置，消费者按序号判断槽是否已写好。
+    push/pop都不加锁，也不分配内存，容量须为2的幂。
+*/
+
+template<class T>
+class MpscQueue {
+public:
+    explicit MpscQueue(size_t capacity);
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    bool push(const T &item);   // 任意线程调用，队列满时返回false
+    bool pop(T &item);          // 只能由唯一的消费者线程调用，队列空时返回false
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    char pad0_[64];
+    std::atomic<size_t> tail_;   // 生产者写入位置
+    char pad1_[64];              // 避免生产者与消费者的位置落在同一缓存行
+    size_t head_;                // 消费者读取位置
+};
+
+template<class T>
+MpscQueue<T>::MpscQueue(size_t capacity): mask_(capacity - 1),
+        cells_(new Cell[capacity]), tail_(0), head_(0)
+{
+    assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+    for(size_t i=0; i<capacity; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+bool MpscQueue<T>::push(const T &item) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    while(true) {
+        Cell &cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if(diff == 0) {
+            if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0) {
+            return false;
+        }
+        else {
+            pos = tail_.load(std::memory_order_relaxed);
+        }
+    }
+    Cell &cell = cells_[pos & mask_];
+    cell.data = item;
+    cell.seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<class T>
+bool MpscQueue<T>::pop(T &item) {
+    Cell &cell = cells_[head_ & mask_];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if(static_cast<intptr_t>(seq) - static_cast<intptr_t>(head_ + 1) < 0)
+        return false;
+    item = cell.data;
+    cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+    head_++;
+    return true;
+}
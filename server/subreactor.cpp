@@ -0,0 +1,244 @@
+#include "subreactor.h"
+
+SubReactor::SubReactor(int id, int timeoutMs, uint32_t connEvent, ThreadPool* workers):
+        id_(id), timeoutMs_(timeoutMs), connEvent_(connEvent), listenFd_(-1), listenEvent_(0),
+        wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), isClose_(false), connCount_(0),
+        timer_(new HeapTimer()), epoller_(new Epoller()), users_(new ConnTable<HttpConn>(MAX_FD)),
+        workers_(workers), completeQue_(MAX_FD), workerState_(new uint8_t[MAX_FD]()), workingCnt_(0)
+{
+    assert(workers_);
+    assert(wakeupFd_ >= 0);
+    epoller_->AddFd(wakeupFd_, EPOLLIN);
+}
+
+SubReactor::~SubReactor() {
+    Stop();
+    if(listenFd_ >= 0)
+        close(listenFd_);
+    close(wakeupFd_);
+}
+
+void SubReactor::SetListenFd(int listenFd, uint32_t listenEvent) {
+    assert(listenFd >= 0 && listenFd_ < 0);
+    listenFd_ = listenFd;
+    listenEvent_ = listenEvent;
+    epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+}
+
+void SubReactor::Start() {
+    thread_ = std::thread([this] { Loop_(); });
+}
+
+void SubReactor::Stop() {
+    isClose_ = true;
+    Wakeup_();
+    Join();
+}
+
+void SubReactor::Join() {
+    if(thread_.joinable())
+        thread_.join();
+}
+
+void SubReactor::AddConn(int fd, const sockaddr_in &addr) {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        pending_.emplace_back(fd, addr);
+    }
+    connCount_++;
+    Wakeup_();
+}
+
+void SubReactor::Wakeup_() {
+    uint64_t one = 1;
+    ssize_t n = ::write(wakeupFd_, &one, sizeof(one));
+    if(n != sizeof(one)) {
+        LOG_WARN("SubReactor[%d] wakeup error!", id_);
+    }
+}
+
+void SubReactor::HandleWakeup_() {
+    uint64_t cnt;
+    ::read(wakeupFd_, &cnt, sizeof(cnt));
+
+    std::vector<std::pair<int, sockaddr_in>> conns;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        conns.swap(pending_);
+    }
+    for(auto &item : conns) {
+        AddClient_(item.first, item.second);
+    }
+    DealComplete_();
+}
+
+void SubReactor::Loop_() {
+    int timeMS = -1;
+    LOG_INFO("SubReactor[%d] start", id_);
+    while(!isClose_) {
+        if(timeoutMs_ > 0)
+            timeMS = timer_->GetNextTick();
+
+        int evenCnt = epoller_->wait(timeMS);
+        HttpResponse::RefreshDate();
+        for(int i=0; i<evenCnt; i++) {
+            int fd = epoller_->GetEventFd(i);
+            uint32_t events = epoller_->GetEvents(i);
+            if(fd == wakeupFd_) {
+                HandleWakeup_();
+            }
+            else if(fd == listenFd_) {
+                DealListen_();
+            }
+            else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                CloseConn_(users_->Get(fd));
+            }
+            else if(events & EPOLLIN) {
+                DealRead_(users_->Get(fd));
+            }
+            else if(events & EPOLLOUT) {
+                DealWrite_(users_->Get(fd));
+            }
+            else {
+                LOG_ERROR("Unexpected event");
+            }
+        }
+    }
+    // 线程池中的任务还会访问连接和完成队列，等它们结束后才能析构
+    while(workingCnt_ > 0)
+        std::this_thread::yield();
+}
+
+// accept4直接得到非阻塞fd，省去每个连接一次fcntl
+void SubReactor::DealListen_() {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    do {
+        int fd = accept4(listenFd_, (struct sockaddr*)&addr, &len, SOCK_NONBLOCK);
+        if(fd <= 0) {
+            return;
+        }
+        else if(HttpConn::userCount >= HttpConn::maxConn || !users_->Contains(fd)) {
+            const char info[] = "Server busy!";
+            send(fd, info, sizeof(info) - 1, 0);
+            close(fd);
+            LOG_WARN("Client is full!");
+            return;
+        }
+        connCount_++;
+        AddClient_(fd, addr);
+    } while(listenEvent_ & EPOLLET);
+}
+
+void SubReactor::AddClient_(int fd, sockaddr_in addr) {
+    assert(fd > 0);
+    HttpConn* client = users_->Open(fd);
+    client->init(fd, addr);
+    if(timeoutMs_ > 0) {
+        // 连接关闭后fd可能被本Reactor重新接管，旧连接过期的回调必须丢弃
+        uint32_t gen = users_->Generation(fd);
+        timer_->add(fd, HttpConn::IdleTimeoutMs(), [this, client, fd, gen]() {
+            if(!users_->IsCurrent(fd, gen))
+                return;
+            // 正在线程池中处理的连接等完成记录到达后再关
+            if(workerState_[fd] != WORKER_IDLE)
+                workerState_[fd] = WORKER_BUSY_CLOSE;
+            else
+                CloseConn_(client);
+        });
+    }
+    epoller_->AddFd(fd, EPOLLIN | connEvent_);
+}
+
+// 超时回调也在本线程执行，不会与读写并发；
+// 连接关闭（close(fd)）之后才释放槽位，之前取得的代数在此之前一直有效
+void SubReactor::CloseConn_(HttpConn* client) {
+    assert(client);
+    int fd = client->GetFd();
+    bool registered = epoller_->DelFd(fd);
+    client->Close();
+    if(registered) {
+        connCount_--;
+        users_->Release(fd);
+    }
+}
+
+void SubReactor::ExtentTime_(HttpConn* client) {
+    assert(client);
+    if(timeoutMs_ > 0)
+        timer_->adjust(client->GetFd(), HttpConn::IdleTimeoutMs());
+}
+
+void SubReactor::DealRead_(HttpConn* client) {
+    assert(client);
+    ExtentTime_(client);
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno);
+    if(ret <= 0 && readErrno != EAGAIN) {
+        CloseConn_(client);
+        return;
+    }
+    OnProcess_(client);
+}
+
+void SubReactor::OnProcess_(HttpConn* client) {
+    if(client->process(false)) {
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+    } else if(client->HandlerPending()) {
+        DispatchTask_(client);
+    } else {
+        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+    }
+}
+
+// 连接注册了EPOLLONESHOT，交给线程池期间不重新监听，本线程不会再碰它
+void SubReactor::DispatchTask_(HttpConn* client) {
+    int fd = client->GetFd();
+    uint32_t gen = users_->Generation(fd);
+    workerState_[fd] = WORKER_BUSY;
+    workingCnt_++;
+    workers_->AddTask([this, client, fd, gen]() {
+        Completion item = { fd, gen, client->process() };
+        while(!completeQue_.push(item)) {
+            // 每个连接同一时刻最多一条记录，容量为MAX_FD时不会满
+            std::this_thread::yield();
+        }
+        Wakeup_();
+        workingCnt_--;
+    });
+}
+
+void SubReactor::DealComplete_() {
+    Completion item;
+    while(completeQue_.pop(item)) {
+        if(!users_->IsCurrent(item.fd, item.gen))
+            continue;
+        HttpConn* client = users_->Get(item.fd);
+        bool closeLater = (workerState_[item.fd] == WORKER_BUSY_CLOSE);
+        workerState_[item.fd] = WORKER_IDLE;
+        if(closeLater)
+            CloseConn_(client);
+        else
+            epoller_->ModFd(item.fd, connEvent_ | (item.hasOutput ? EPOLLOUT : EPOLLIN));
+    }
+}
+
+void SubReactor::DealWrite_(HttpConn* client) {
+    assert(client);
+    ExtentTime_(client);
+    int writeErrno = 0;
+    ssize_t ret = client->write(&writeErrno);
+    if(client->ToWriteBytes() == 0) {
+        if(client->IsKeepAlive()) {
+            OnProcess_(client);
+            return;
+        }
+    }
+    else if(ret < 0) {
+        if(writeErrno == EAGAIN) {
+            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+            return;
+        }
+    }
+    CloseConn_(client);
+}
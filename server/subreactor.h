@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+
+#include "epoller.h"
+#include "conntable.h"
+#include "mpscqueue.h"
+#include "../log/log.h"
+#include "../pool/treadpool.h"
+#include "../http/httpconn.h"
+#include "../timer/heaptimer.h"
+
+/*
+    从Reactor（one loop per thread）：
+    主Reactor只负责accept，把新连接通过AddConn交给从Reactor；
+    SO_REUSEPORT模式下没有主Reactor，每个从Reactor在自己的监听socket上accept；
+    每个从Reactor在自己的线程中运行独立的Epoller、HeapTimer和连接表，Reactor之间不共享连接状态，
+    读、解析、写都在本线程内完成，不存在跨线程的epoll_ctl；
+    只有注册了处理函数的请求（可能访问数据库而阻塞）交给线程池，
+    完成后经完成队列和wakeupFd_回到本线程重新监听。
+*/
+
+class SubReactor {
+public:
+    SubReactor(int id, int timeoutMs, uint32_t connEvent, ThreadPool* workers);
+    ~SubReactor();
+
+    void Start();
+    void Stop();
+    void Join();
+
+    // SO_REUSEPORT模式下由本Reactor持有并accept自己的监听socket，需在Start之前调用
+    void SetListenFd(int listenFd, uint32_t listenEvent);
+
+    // 由主Reactor线程调用，线程安全
+    void AddConn(int fd, const sockaddr_in &addr);
+
+    // 当前负责的连接数，主Reactor据此选择负载最小的从Reactor
+    int ConnCount() const { return connCount_; }
+    int Id() const { return id_; }
+
+    static const int MAX_FD = 65536;
+
+private:
+    // 线程池处理完一个连接的记录，hasOutput为process()的返回值
+    struct Completion {
+        int fd;
+        uint32_t gen;
+        bool hasOutput;
+    };
+
+    // 连接在线程池中的状态，只在本线程中读写
+    enum WorkerState : uint8_t {
+        WORKER_IDLE = 0,
+        WORKER_BUSY,            // 已交给线程池，尚未完成
+        WORKER_BUSY_CLOSE,      // 处理期间超时，完成后直接关闭
+    };
+
+    void Loop_();
+    void Wakeup_();
+    void HandleWakeup_();
+    void DealListen_();
+
+    void AddClient_(int fd, sockaddr_in addr);
+    void CloseConn_(HttpConn* client);
+    void ExtentTime_(HttpConn* client);
+
+    void DealRead_(HttpConn* client);
+    void DealWrite_(HttpConn* client);
+    void OnProcess_(HttpConn* client);
+    void DispatchTask_(HttpConn* client);
+    void DealComplete_();
+
+    int id_;
+    int timeoutMs_;
+    uint32_t connEvent_;
+    int listenFd_;                      // 仅SO_REUSEPORT模式下有效，否则为-1
+    uint32_t listenEvent_;
+    int wakeupFd_;                      // eventfd，主Reactor交来新连接或线程池处理完时唤醒本Reactor
+    std::atomic<bool> isClose_;
+    std::atomic<int> connCount_;
+
+    std::mutex mtx_;
+    std::vector<std::pair<int, sockaddr_in>> pending_;  // 待接管的新连接
+
+    std::unique_ptr<HeapTimer> timer_;
+    std::unique_ptr<Epoller> epoller_;
+    std::unique_ptr<ConnTable<HttpConn>> users_;   // 本Reactor接管的连接，fd关闭后被其他Reactor复用也不会碰到同一个槽
+
+    ThreadPool* workers_;                          // 由WebServer持有，各Reactor共用
+    MpscQueue<Completion> completeQue_;
+    std::unique_ptr<uint8_t[]> workerState_;
+    std::atomic<int> workingCnt_;                  // 已交给线程池尚未完成的任务数，退出前等它归零
+    std::thread thread_;
+};
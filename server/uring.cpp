@@ -0,0 +1,193 @@
+#include "uring.h"
+
+Uring::Uring(unsigned entries): ringFd_(-1), features_(0), toSubmit_(0),
+        sqPtr_(MAP_FAILED), cqPtr_(MAP_FAILED), sqSize_(0), cqSize_(0),
+        sqes_(nullptr), sqesSize_(0), bufRing_(nullptr), bufRingSize_(0),
+        bufMask_(0), bufSize_(0)
+{
+    // 优先使用COOP_TASKRUN减少IPI，老内核不认识这些标志时退回默认参数
+    if(!Setup_(entries, IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN))
+        Setup_(entries, 0);
+}
+
+Uring::~Uring() {
+    Release_();
+}
+
+bool Uring::Setup_(unsigned entries, unsigned flags) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if(fd < 0)
+        return false;
+
+    // 需要单次mmap和带超时的io_uring_enter
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG)) {
+        close(fd);
+        return false;
+    }
+    ringFd_ = fd;
+    features_ = p.features;
+
+    sqSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(cqSize_ > sqSize_) sqSize_ = cqSize_;
+    cqSize_ = sqSize_;
+
+    sqPtr_ = mmap(nullptr, sqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringFd_, IORING_OFF_SQ_RING);
+    if(sqPtr_ == MAP_FAILED) {
+        Release_();
+        return false;
+    }
+    cqPtr_ = sqPtr_;
+
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd_, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) {
+        Release_();
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqPtr_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    // SQE与数组下标一一对应，之后只需推进tail
+    for(unsigned i=0; i<sqEntries_; i++)
+        sqArray_[i] = i;
+
+    char* cq = static_cast<char*>(cqPtr_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + p.cq_off.cqes);
+    return true;
+}
+
+void Uring::Release_() {
+    if(bufRing_) {
+        munmap(bufRing_, bufRingSize_);
+        bufRing_ = nullptr;
+    }
+    if(sqes_) {
+        munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if(sqPtr_ != MAP_FAILED) {
+        munmap(sqPtr_, sqSize_);
+        sqPtr_ = cqPtr_ = MAP_FAILED;
+    }
+    if(ringFd_ >= 0) {
+        close(ringFd_);
+        ringFd_ = -1;
+    }
+}
+
+struct io_uring_sqe* Uring::GetSqe() {
+    assert(IsValid());
+    unsigned tail = *sqTail_;
+    if(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        // SQ已满，先把已有的提交给内核
+        syscall(__NR_io_uring_enter, ringFd_, toSubmit_, 0, 0, nullptr, 0);
+        toSubmit_ = 0;
+        if(tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+            return nullptr;
+    }
+    struct io_uring_sqe* sqe = &sqes_[tail & sqMask_];
+    memset(sqe, 0, sizeof(*sqe));
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    toSubmit_++;
+    return sqe;
+}
+
+int Uring::SubmitAndWait(int timeoutMs) {
+    assert(IsValid());
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    unsigned minComplete = 1;
+    // 已经有完成事件时只提交不等待
+    if(__atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_) {
+        if(toSubmit_ == 0)
+            return 0;
+        flags = 0;
+        minComplete = 0;
+    }
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if(minComplete && timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+
+    int ret = syscall(__NR_io_uring_enter, ringFd_, toSubmit_, minComplete, flags, &arg, sizeof(arg));
+    if(ret >= 0) {
+        toSubmit_ = 0;
+    }
+    else if(errno == ETIME || errno == EINTR) {
+        // 超时或被信号打断时SQE也已经提交
+        toSubmit_ = 0;
+        ret = 0;
+    }
+    return ret;
+}
+
+bool Uring::PeekCqe(struct io_uring_cqe* cqe) {
+    unsigned head = *cqHead_;
+    if(head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+        return false;
+    *cqe = cqes_[head & cqMask_];
+    __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool Uring::RegisterBufRing(uint16_t bgid, unsigned count, unsigned size) {
+    assert(IsValid() && count > 0 && (count & (count - 1)) == 0 && count <= 32768);
+    bufRingSize_ = count * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, bufRingSize_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ring == MAP_FAILED)
+        return false;
+    bufRing_ = static_cast<struct io_uring_buf_ring*>(ring);
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(bufRing_);
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if(syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(bufRing_, bufRingSize_);
+        bufRing_ = nullptr;
+        return false;
+    }
+
+    bufMask_ = count - 1;
+    bufSize_ = size;
+    bufs_.resize(static_cast<size_t>(count) * size);
+    for(unsigned i=0; i<count; i++) {
+        struct io_uring_buf* buf = BufEntry_(i);
+        buf->addr = reinterpret_cast<uint64_t>(GetBuf(i));
+        buf->len = size;
+        buf->bid = i;
+    }
+    __atomic_store_n(&bufRing_->tail, static_cast<uint16_t>(count), __ATOMIC_RELEASE);
+    return true;
+}
+
+// 把用完的缓冲区放回ring尾部，供后续recv再次选择
+void Uring::RecycleBuf(uint16_t bid) {
+    uint16_t tail = bufRing_->tail;
+    struct io_uring_buf* buf = BufEntry_(tail & bufMask_);
+    buf->addr = reinterpret_cast<uint64_t>(GetBuf(bid));
+    buf->len = bufSize_;
+    buf->bid = bid;
+    __atomic_store_n(&bufRing_->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
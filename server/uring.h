@@ -0,0 +1,78 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+    io_uring的最小封装，不依赖liburing，直接使用io_uring_setup/io_uring_enter/io_uring_register。
+    只提供服务器需要的部分：取SQE、批量提交并等待、遍历CQE、provided buffer ring。
+    与Epoller一样只在一个线程中使用。
+*/
+
+class Uring {
+public:
+    explicit Uring(unsigned entries = 1024);
+    ~Uring();
+
+    // 内核不支持或被禁用时返回false，调用方应回退到epoll
+    bool IsValid() const { return ringFd_ >= 0; }
+
+    // 返回一个已清零的SQE；SQ满时先提交一次再取
+    struct io_uring_sqe* GetSqe();
+
+    // 提交所有未提交的SQE，并在没有可取的CQE时等待至少一个完成或超时
+    int SubmitAndWait(int timeoutMs = -1);
+
+    // 取出一个CQE，没有时返回false
+    bool PeekCqe(struct io_uring_cqe* cqe);
+
+    // 注册provided buffer ring：count个大小为size的缓冲区，count须为2的幂
+    bool RegisterBufRing(uint16_t bgid, unsigned count, unsigned size);
+    char* GetBuf(uint16_t bid) { return &bufs_[static_cast<size_t>(bid) * bufSize_]; }
+    void RecycleBuf(uint16_t bid);
+
+private:
+    bool Setup_(unsigned entries, unsigned flags);
+    void Release_();
+
+    // C++下__DECLARE_FLEX_ARRAY会在bufs前多出一个空结构体，导致bufs偏移8字节，
+    // 这里按内核的布局直接从ring起始地址取第i项
+    struct io_uring_buf* BufEntry_(unsigned i) {
+        return reinterpret_cast<struct io_uring_buf*>(bufRing_) + i;
+    }
+
+    int ringFd_;
+    unsigned features_;
+    unsigned toSubmit_;           // 已填写但还未交给内核的SQE数量
+
+    void* sqPtr_;
+    void* cqPtr_;
+    size_t sqSize_;
+    size_t cqSize_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned* sqArray_;
+
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    struct io_uring_buf_ring* bufRing_;
+    size_t bufRingSize_;
+    unsigned bufMask_;
+    unsigned bufSize_;
+    std::vector<char> bufs_;
+};
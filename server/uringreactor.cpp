@@ -0,0 +1,412 @@
+#include "uringreactor.h"
+
+UringReactor::UringReactor(int id, int timeoutMs, ThreadPool* workers):
+        id_(id), timeoutMs_(timeoutMs), listenFd_(-1), ownListenFd_(false),
+        wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), wakeupVal_(0), isClose_(false),
+        timer_(new HeapTimer()), users_(new ConnTable<Conn>(MAX_FD)),
+        workers_(workers), completeQue_(MAX_FD), workingCnt_(0)
+{
+    assert(workers_);
+    assert(wakeupFd_ >= 0);
+}
+
+UringReactor::~UringReactor() {
+    Stop();
+    if(ownListenFd_ && listenFd_ >= 0)
+        close(listenFd_);
+    close(wakeupFd_);
+}
+
+bool UringReactor::Init() {
+    ring_.reset(new Uring(RING_ENTRIES));
+    if(!ring_->IsValid()) {
+        LOG_WARN("UringReactor[%d] io_uring setup error!", id_);
+        return false;
+    }
+    if(!ring_->RegisterBufRing(BUF_GROUP, BUF_COUNT, BUF_SIZE)) {
+        LOG_WARN("UringReactor[%d] register buffer ring error!", id_);
+        return false;
+    }
+    if(!ProbeRecvMultishot_()) {
+        LOG_WARN("UringReactor[%d] multishot recv unsupported!", id_);
+        return false;
+    }
+    return true;
+}
+
+/*
+    multishot recv需要6.0内核，而EXT_ARG和buffer ring在5.19就有了，opcode探测也区分不出来，
+    这里在socketpair上实际挂一个试试：不认识该标志的内核直接返回-EINVAL，
+    支持时收到数据的CQE带IORING_CQE_F_MORE；之后关闭写端让它以EOF结束，不留下未完成的请求
+*/
+bool UringReactor::ProbeRecvMultishot_() {
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        return false;
+    bool supported = false;
+    bool armed = false;
+    if(::write(sv[1], "x", 1) == 1) {
+        struct io_uring_sqe* sqe = ring_->GetSqe();
+        assert(sqe);
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = sv[0];
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUF_GROUP;
+        sqe->user_data = MakeData_(OP_RECV, sv[0]);
+        armed = true;
+    }
+
+    struct io_uring_cqe cqe;
+    for(int i = 0; armed && i < PROBE_WAIT_ROUNDS; i++) {
+        ring_->SubmitAndWait(PROBE_WAIT_MS);
+        while(armed && ring_->PeekCqe(&cqe)) {
+            if(cqe.flags & IORING_CQE_F_BUFFER)
+                ring_->RecycleBuf(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            armed = cqe.flags & IORING_CQE_F_MORE;
+            if(cqe.res == 1 && armed) {
+                supported = true;
+                shutdown(sv[1], SHUT_WR);
+            }
+        }
+    }
+    close(sv[0]);
+    close(sv[1]);
+    // 探测请求没能按时结束时也按不支持处理，这个ring随即被丢弃
+    return supported && !armed;
+}
+
+void UringReactor::SetListenFd(int listenFd, bool owned) {
+    assert(listenFd >= 0 && listenFd_ < 0);
+    listenFd_ = listenFd;
+    ownListenFd_ = owned;
+}
+
+void UringReactor::Start() {
+    thread_ = std::thread([this] { Loop_(); });
+}
+
+void UringReactor::Stop() {
+    isClose_ = true;
+    uint64_t one = 1;
+    if(::write(wakeupFd_, &one, sizeof(one)) != sizeof(one)) {
+        LOG_WARN("UringReactor[%d] wakeup error!", id_);
+    }
+    Join();
+}
+
+void UringReactor::Join() {
+    if(thread_.joinable())
+        thread_.join();
+}
+
+void UringReactor::Loop_() {
+    assert(ring_ && ring_->IsValid() && listenFd_ >= 0);
+    LOG_INFO("UringReactor[%d] start", id_);
+    PrepWakeup_();
+    PrepAccept_();
+
+    struct io_uring_cqe cqe;
+    while(!isClose_) {
+        int timeMS = -1;
+        if(timeoutMs_ > 0)
+            timeMS = timer_->GetNextTick();
+
+        // 上一轮产生的SQE在这里一次性提交
+        ring_->SubmitAndWait(timeMS);
+        HttpResponse::RefreshDate();
+        while(ring_->PeekCqe(&cqe)) {
+            Dispatch_(cqe);
+        }
+    }
+    // 线程池中的任务还会访问连接和完成队列，等它们结束后才能析构
+    while(workingCnt_ > 0)
+        std::this_thread::yield();
+}
+
+void UringReactor::Dispatch_(const struct io_uring_cqe &cqe) {
+    Op op = static_cast<Op>(cqe.user_data >> 32);
+    int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+    switch(op) {
+        case OP_ACCEPT:
+            OnAccept_(cqe);
+            break;
+        case OP_WAKEUP:
+            if(!isClose_)
+                PrepWakeup_();
+            DealComplete_();
+            break;
+        case OP_RECV:
+            OnRecv_(*users_->Get(fd), cqe);
+            break;
+        case OP_SEND:
+            OnSend_(*users_->Get(fd), cqe);
+            break;
+        case OP_CANCEL: {
+            Conn* conn = users_->Get(fd);
+            conn->inflight--;
+            TryRelease_(*conn);
+            break;
+        }
+        default:
+            LOG_ERROR("Unexpected cqe");
+            break;
+    }
+}
+
+void UringReactor::PrepAccept_() {
+    struct io_uring_sqe* sqe = ring_->GetSqe();
+    assert(sqe);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = MakeData_(OP_ACCEPT, listenFd_);
+}
+
+void UringReactor::PrepWakeup_() {
+    struct io_uring_sqe* sqe = ring_->GetSqe();
+    assert(sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeupFd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeupVal_);
+    sqe->len = sizeof(wakeupVal_);
+    sqe->user_data = MakeData_(OP_WAKEUP, wakeupFd_);
+}
+
+void UringReactor::PrepRecv_(Conn &conn) {
+    struct io_uring_sqe* sqe = ring_->GetSqe();
+    assert(sqe);
+    int fd = conn.http.GetFd();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = MakeData_(OP_RECV, fd);
+    conn.recving = true;
+    conn.inflight++;
+}
+
+// 整批响应的iovec用一个SENDMSG提交，MSG_WAITALL让内核处理部分发送
+void UringReactor::PrepSend_(Conn &conn) {
+    int fd = conn.http.GetFd();
+    if(conn.http.GetIovCnt() == 0) {
+        // 文件映射失败，无法继续发送
+        CloseConn_(&conn);
+        return;
+    }
+    memset(&conn.msg, 0, sizeof(conn.msg));
+    conn.msg.msg_iov = const_cast<struct iovec*>(conn.http.GetIov());
+    conn.msg.msg_iovlen = conn.http.GetIovCnt();
+    conn.sendLeft = 1;
+    conn.sendBytes = 0;
+    conn.sendErr = 0;
+
+    struct io_uring_sqe* sqe = ring_->GetSqe();
+    assert(sqe);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&conn.msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->user_data = MakeData_(OP_SEND, fd);
+    conn.inflight++;
+}
+
+void UringReactor::OnAccept_(const struct io_uring_cqe &cqe) {
+    if(!(cqe.flags & IORING_CQE_F_MORE) && !isClose_) {
+        PrepAccept_();
+    }
+    int fd = cqe.res;
+    if(fd < 0) {
+        if(fd != -ECANCELED)
+            LOG_WARN("UringReactor[%d] accept error:%d", id_, -fd);
+        return;
+    }
+    if(HttpConn::userCount >= HttpConn::maxConn || !users_->Contains(fd)) {
+        const char info[] = "Server busy!";
+        send(fd, info, sizeof(info) - 1, MSG_DONTWAIT);
+        close(fd);
+        LOG_WARN("Client is full!");
+        return;
+    }
+
+    // multishot accept不返回对端地址
+    struct sockaddr_in addr = {0};
+    Conn &conn = *users_->Open(fd);
+    assert(!conn.active && conn.inflight == 0);
+    conn.http.init(fd, addr);
+    conn.active = true;
+    conn.closing = false;
+    if(timeoutMs_ > 0) {
+        uint32_t gen = users_->Generation(fd);
+        Conn* pconn = &conn;
+        timer_->add(fd, HttpConn::IdleTimeoutMs(), [this, pconn, fd, gen]() {
+            if(users_->IsCurrent(fd, gen))
+                CloseConn_(pconn);
+        });
+    }
+    PrepRecv_(conn);
+}
+
+void UringReactor::OnRecv_(Conn &conn, const struct io_uring_cqe &cqe) {
+    if(cqe.flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+        if(cqe.res > 0 && !conn.closing) {
+            if(conn.working)
+                conn.stash.Append(ring_->GetBuf(bid), cqe.res);
+            else
+                conn.http.AppendRead(ring_->GetBuf(bid), cqe.res);
+        }
+        ring_->RecycleBuf(bid);
+    }
+    if(!(cqe.flags & IORING_CQE_F_MORE)) {
+        conn.recving = false;
+        conn.inflight--;
+    }
+    if(conn.closing) {
+        TryRelease_(conn);
+        return;
+    }
+
+    if(cqe.res == -ENOBUFS) {
+        // provided buffer暂时用完，重新挂上recv
+        if(!conn.recving)
+            PrepRecv_(conn);
+        return;
+    }
+    if(cqe.res <= 0) {
+        CloseConn_(&conn);
+        return;
+    }
+    if(!conn.recving)
+        PrepRecv_(conn);
+
+    ExtentTime_(conn);
+    if(conn.sendLeft == 0 && !conn.working)
+        OnProcess_(conn);
+}
+
+void UringReactor::OnSend_(Conn &conn, const struct io_uring_cqe &cqe) {
+    conn.inflight--;
+    conn.sendLeft--;
+    if(cqe.res < 0)
+        conn.sendErr = cqe.res;
+    else
+        conn.sendBytes += cqe.res;
+
+    if(conn.sendLeft > 0)
+        return;
+    if(conn.closing) {
+        TryRelease_(conn);
+        return;
+    }
+    if(conn.sendErr < 0) {
+        CloseConn_(&conn);
+        return;
+    }
+
+    conn.http.Advance(conn.sendBytes);
+    if(conn.http.ToWriteBytes() > 0) {
+        PrepSend_(conn);
+        return;
+    }
+    if(conn.http.IsKeepAlive()) {
+        // 发送期间可能已经收到了下一个请求
+        OnProcess_(conn);
+        return;
+    }
+    CloseConn_(&conn);
+}
+
+void UringReactor::OnProcess_(Conn &conn) {
+    if(conn.http.process(false)) {
+        if(conn.http.ToWriteBytes() > 0)
+            PrepSend_(conn);
+    }
+    else if(conn.http.HandlerPending()) {
+        DispatchTask_(conn);
+    }
+}
+
+// 任务计入inflight：处理期间连接被关闭时，等任务完成后才真正释放
+void UringReactor::DispatchTask_(Conn &conn) {
+    int fd = conn.http.GetFd();
+    uint32_t gen = users_->Generation(fd);
+    Conn* pconn = &conn;
+    conn.working = true;
+    conn.inflight++;
+    workingCnt_++;
+    workers_->AddTask([this, pconn, fd, gen]() {
+        Completion item = { fd, gen, pconn->http.process() };
+        while(!completeQue_.push(item)) {
+            // 每个连接同一时刻最多一条记录，容量为MAX_FD时不会满
+            std::this_thread::yield();
+        }
+        uint64_t one = 1;
+        if(::write(wakeupFd_, &one, sizeof(one)) != sizeof(one)) {
+            LOG_WARN("UringReactor[%d] wakeup error!", id_);
+        }
+        workingCnt_--;
+    });
+}
+
+void UringReactor::DealComplete_() {
+    Completion item;
+    while(completeQue_.pop(item)) {
+        if(!users_->IsCurrent(item.fd, item.gen))
+            continue;
+        Conn &conn = *users_->Get(item.fd);
+        conn.working = false;
+        conn.inflight--;
+        if(conn.closing) {
+            conn.stash.ReleaseStorage();
+            TryRelease_(conn);
+            continue;
+        }
+        if(conn.stash.ReadableBytes() > 0) {
+            conn.http.AppendRead(conn.stash.Peek(), conn.stash.ReadableBytes());
+            conn.stash.ReleaseStorage();
+        }
+        if(!item.hasOutput)
+            OnProcess_(conn);
+        else if(conn.http.ToWriteBytes() > 0)
+            PrepSend_(conn);
+    }
+}
+
+// 取消该fd上所有未完成的请求，全部完成后再关闭fd，避免fd被复用后收到旧的完成事件
+void UringReactor::CloseConn_(Conn* conn) {
+    assert(conn);
+    if(!conn->active || conn->closing)
+        return;
+    conn->closing = true;
+    if(conn->inflight > 0) {
+        struct io_uring_sqe* sqe = ring_->GetSqe();
+        assert(sqe);
+        int fd = conn->http.GetFd();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = MakeData_(OP_CANCEL, fd);
+        conn->inflight++;
+    }
+    TryRelease_(*conn);
+}
+
+void UringReactor::TryRelease_(Conn &conn) {
+    if(!conn.closing || conn.inflight > 0)
+        return;
+    conn.active = false;
+    conn.closing = false;
+    conn.sendLeft = 0;
+    int fd = conn.http.GetFd();
+    conn.http.Close();
+    users_->Release(fd);
+}
+
+void UringReactor::ExtentTime_(Conn &conn) {
+    if(timeoutMs_ > 0)
+        timer_->adjust(conn.http.GetFd(), HttpConn::IdleTimeoutMs());
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "uring.h"
+#include "conntable.h"
+#include "mpscqueue.h"
+#include "../log/log.h"
+#include "../pool/treadpool.h"
+#include "../http/httpconn.h"
+#include "../timer/heaptimer.h"
+
+/*
+    基于io_uring的完成式事件循环，可替代Epoller + SubReactor：
+    - 监听socket上挂一个multishot accept，新连接不需要再次提交；
+    - 每个连接挂一个multishot recv，数据由内核写入provided buffer ring，拷进readBuff_后立即归还；
+    - 一批流水线响应（响应头和文件内容）的所有iovec用一个SENDMSG发送；
+    - 一轮事件处理中产生的所有SQE在下一次io_uring_enter中一次性提交，同时等待新的完成事件。
+    每个UringReactor在自己的线程中运行，连接只在本线程内处理；注册了处理函数的请求
+    （可能访问数据库而阻塞）交给线程池，期间收到的数据先暂存，完成后经wakeupFd_回到本线程。
+*/
+
+class UringReactor {
+public:
+    UringReactor(int id, int timeoutMs, ThreadPool* workers);
+    ~UringReactor();
+
+    // 创建io_uring与provided buffer ring并确认支持multishot recv，内核不支持时返回false
+    bool Init();
+
+    // owned为true时由本Reactor负责关闭（SO_REUSEPORT模式），需在Start之前调用
+    void SetListenFd(int listenFd, bool owned);
+
+    void Start();
+    void Stop();
+    void Join();
+
+private:
+    enum Op : uint8_t {
+        OP_ACCEPT = 1,
+        OP_RECV,
+        OP_SEND,
+        OP_CANCEL,
+        OP_WAKEUP,
+    };
+
+    struct Conn {
+        HttpConn http;
+        bool active = false;
+        bool closing = false;
+        bool recving = false;        // multishot recv是否仍然有效
+        int inflight = 0;            // 尚未完成的SQE数，为0后才能真正close(fd)
+        int sendLeft = 0;            // 尚未完成的SENDMSG数
+        size_t sendBytes = 0;
+        int sendErr = 0;
+        bool working = false;        // 在线程池中处理，计入inflight
+        Buffer stash;                // 处理期间收到的数据，完成后再交给http
+        struct msghdr msg;           // SENDMSG完成前内核会访问，须与连接同生命周期
+    };
+
+    // 线程池处理完一个连接的记录，hasOutput为process()的返回值
+    struct Completion {
+        int fd;
+        uint32_t gen;
+        bool hasOutput;
+    };
+
+    static uint64_t MakeData_(Op op, int fd) {
+        return (static_cast<uint64_t>(op) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    bool ProbeRecvMultishot_();
+    void Loop_();
+    void Dispatch_(const struct io_uring_cqe &cqe);
+
+    void PrepAccept_();
+    void PrepWakeup_();
+    void PrepRecv_(Conn &conn);
+    void PrepSend_(Conn &conn);
+
+    void OnAccept_(const struct io_uring_cqe &cqe);
+    void OnRecv_(Conn &conn, const struct io_uring_cqe &cqe);
+    void OnSend_(Conn &conn, const struct io_uring_cqe &cqe);
+    void OnProcess_(Conn &conn);
+    void DispatchTask_(Conn &conn);
+    void DealComplete_();
+
+    void CloseConn_(Conn* conn);
+    void TryRelease_(Conn &conn);
+    void ExtentTime_(Conn &conn);
+
+    static const int MAX_FD = 65536;
+    static const unsigned RING_ENTRIES = 4096;
+    static const unsigned BUF_COUNT = 1024;      // provided buffer数量，须为2的幂
+    static const unsigned BUF_SIZE = 4096;
+    static const uint16_t BUF_GROUP = 0;
+    static const int PROBE_WAIT_ROUNDS = 4;      // 探测multishot recv时最多等待4次、每次250ms
+    static const int PROBE_WAIT_MS = 250;
+
+    int id_;
+    int timeoutMs_;
+    int listenFd_;
+    bool ownListenFd_;
+    int wakeupFd_;
+    uint64_t wakeupVal_;
+    std::atomic<bool> isClose_;
+
+    std::unique_ptr<Uring> ring_;
+    std::unique_ptr<HeapTimer> timer_;
+    std::unique_ptr<ConnTable<Conn>> users_;
+
+    ThreadPool* workers_;                        // 由WebServer持有，各Reactor共用
+    MpscQueue<Completion> completeQue_;
+    std::atomic<int> workingCnt_;                // 已交给线程池尚未完成的任务数，退出前等它归零
+    std::thread thread_;
+};
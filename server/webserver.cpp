@@ -4,9 +4,15 @@ WebServer::WebServer(
     int port, int trigMode, int timeoutMs, bool OptLinger,
         int sqlPort, const char* sqlUser, const char* sqlPwd,
         const char* dbName, int connPoolNum, int thhreadNum,
-        bool openLog, int logLevel, int logQueSize):
+        bool openLog, int logLevel, int logQueSize, int subReactorNum,
+        bool reusePort, int backlog, bool ioUring):
         port_(port), openLinger_(OptLinger), timeoutMs_(timeoutMs), isClose_(false),
-        timer_(new HeapTimer()), threadPool_(new ThreadPool(thhreadNum)), epoller_(new Epoller())
+        reusePort_(reusePort), backlog_(backlog > 0 ? backlog : SOMAXCONN),
+        timer_(new HeapTimer()), threadPool_(new ThreadPool(thhreadNum)), epoller_(new Epoller()),
+        users_(new ConnTable<HttpConn>(MAX_FD)),
+        completeFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), completeNotified_(false),
+        completeQue_(MAX_FD), batchSeq_(new uint32_t[MAX_FD]()), batchIdx_(new uint32_t[MAX_FD]()),
+        batchNo_(0), workerState_(new uint8_t[MAX_FD]()), nextReactor_(0)
 {
     /*
         port: 监听端口号
@@ -22,25 +28,69 @@ WebServer::WebServer(
         openLog: 是否开启日志
         logLevel: 日志记录的级别
         logQueSize: 日志队列大小
+        subReactorNum: 从Reactor数量，0表示单Reactor + 线程池，>0表示主从Reactor
+        reusePort: 每个从Reactor用SO_REUSEPORT绑定自己的监听socket，自行accept
+        backlog: listen的全连接队列长度，<=0时使用SOMAXCONN
+        ioUring: 使用io_uring完成式事件循环代替epoll，内核不支持时自动回退
     */
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strncat(srcDir_, "/resources/", 16);
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
+    // 空闲超时随连接数占上限的比例调整，上限还受进程文件描述符数限制
+    HttpConn::idleTimeoutMs = timeoutMs_;
+    HttpConn::maxConn = MAX_FD;
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < static_cast<rlim_t>(MAX_FD))
+        HttpConn::maxConn = static_cast<int>(rl.rlim_cur);
+    // 日志最先初始化，连接数据库失败的错误才能记录下来
+    if(openLog) {
+        Log::Instance()->Init(logLevel, "./logs", ".log", logQueSize);
+    }
     // std::cout << "srcDir: " << srcDir_ << "\n";
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
     // std::cout << "conncation sql successful.\n";
 
     InitEventMode_(trigMode);
+    bool uringFallback = false;
+    if(ioUring) {
+        // io_uring模式下每个循环线程一个ring，至少一个
+        int n = subReactorNum > 0 ? subReactorNum : 1;
+        for(int i=0; i<n; i++) {
+            std::unique_ptr<UringReactor> reactor(new UringReactor(i, timeoutMs_, threadPool_.get()));
+            if(!reactor->Init()) {
+                uringReactors_.clear();
+                uringFallback = true;
+                break;
+            }
+            uringReactors_.push_back(std::move(reactor));
+        }
+    }
+    // io_uring的SENDMSG需要内存地址，文件内容改用mmap
+    HttpConn::useSendfile = uringReactors_.empty();
+    if(uringReactors_.empty()) {
+        if(reusePort_ && subReactorNum <= 0) {
+            subReactorNum = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for(int i=0; i<subReactorNum; i++) {
+            subReactors_.emplace_back(new SubReactor(i, timeoutMs_, connEvent_, threadPool_.get()));
+        }
+    }
+
     if(!InitSocket_())
         isClose_ = true;
 
+    // 工作线程不再直接epoll_ctl，而是通过完成队列 + eventfd交给Reactor
+    assert(completeFd_ >= 0);
+    if(subReactors_.empty() && uringReactors_.empty()) {
+        epoller_->AddFd(completeFd_, EPOLLIN);
+    }
+
     // std::cout << "isClose: " << isClose_ << "\n";
     // std::cout << "openLog: " << openLog << "\n";
 
     if(openLog) {
-        Log::Instance()->Init(logLevel, "./logs", ".log", logQueSize);
         if(isClose_) {
             LOG_ERROR("=============== Server Init error! ==================");
         }
@@ -53,39 +103,73 @@ WebServer::WebServer(
             LOG_INFO("LogSys level:%d", logLevel);
             LOG_INFO("srcDir:%s", HttpConn::srcDir);
             LOG_INFO("SqlConnPool num:%d, ThreadPool num:%d", connPoolNum, thhreadNum);
+            LOG_INFO("SubReactor num:%d, ReusePort:%s, Backlog:%d",
+                        subReactorNum, reusePort_?"true":"false", backlog_);
+            LOG_INFO("IO backend:%s", uringReactors_.empty()?"epoll":"io_uring");
+            if(uringFallback) {
+                LOG_WARN("io_uring unavailable, fall back to epoll");
+            }
         }
 
 
     }
+    // 静态文件缓存在日志之后初始化，inotify不可用时的警告才能记录下来
+    FileCache::Instance()->Init(srcDir_);
 }
 
 void WebServer::Start() {
     int timeMS = -1;
     if(!isClose_)
         LOG_INFO("=============== Server start ==================");
+
+    // io_uring模式下主线程同样只等待各循环线程退出
+    if(!uringReactors_.empty()) {
+        for(auto &reactor : uringReactors_) {
+            reactor->Start();
+        }
+        for(auto &reactor : uringReactors_) {
+            reactor->Join();
+        }
+        return;
+    }
+
+    for(auto &reactor : subReactors_) {
+        reactor->Start();
+    }
+
+    // SO_REUSEPORT模式下主线程不参与事件循环，只等待各从Reactor退出
+    if(reusePort_) {
+        for(auto &reactor : subReactors_) {
+            reactor->Join();
+        }
+        return;
+    }
     
     while(!isClose_) {
-        if(timeoutMs_>0)
+        // 主从模式下连接的定时器由各从Reactor维护
+        if(timeoutMs_>0 && subReactors_.empty())
             timeMS = timer_->GetNextTick();
         
         int evenCnt = epoller_->wait(timeMS);
+        // 请求总是在Reactor被唤醒之后处理，此时刷新Date即可保证不过期
+        HttpResponse::RefreshDate();
         for(int i=0; i<evenCnt; i++) {
             int fd = epoller_->GetEventFd(i);
             uint32_t events = epoller_->GetEvents(i);
             if(fd == listenFd_) {
                 DealListen_();
             }
+            else if(fd == completeFd_) {
+                DealComplete_();
+            }
             else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
-                assert(users_.count(fd)>0);
-                CloseConn_(&users_[fd]);
+                CloseConn_(users_->Get(fd));
             }
             else if(events & EPOLLIN) {
-                assert(users_.count(fd)>0);
-                DealRead_(&users_[fd]);
+                DealRead_(users_->Get(fd));
             }
             else if(events & EPOLLOUT) {
-                assert(users_.count(fd)>0);
-                DealWrite_(&users_[fd]);
+                DealWrite_(users_->Get(fd));
             }
             else {
                 LOG_ERROR("Unexpected event");
@@ -95,9 +179,14 @@ void WebServer::Start() {
 }
 
 WebServer::~WebServer() {
-    close(listenFd_);
     isClose_ = true;
+    subReactors_.clear();
+    uringReactors_.clear();
+    if(listenFd_ >= 0)
+        close(listenFd_);
+    close(completeFd_);
     free(srcDir_);
+    FileCache::Instance()->Close();
     SqlConnPool::Instance()->ClosePool();
     // LOG_INFO("free all resoueces success!");s
 }
@@ -141,20 +230,33 @@ void WebServer::SendError_(int fd, const char* info) {
 
 void WebServer::CloseConn_(HttpConn *client) {
     assert(client);
-    LOG_INFO("Client[%d] quit!", client->GetFd());
-    epoller_->DelFd(client->GetFd());
+    int fd = client->GetFd();
+    LOG_INFO("Client[%d] quit!", fd);
+    epoller_->DelFd(fd);
     client->Close();
+    users_->Release(fd);
 }
 
 void WebServer::AddClient_(int fd, sockaddr_in addr) {
     assert(fd > 0);
-    users_[fd].init(fd, addr);
+    HttpConn* client = users_->Open(fd);
+    client->init(fd, addr);
     if(timeoutMs_ > 0 ) {
-        timer_->add(fd, timeoutMs_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        // 定时器触发时连接可能早已关闭，用代数过滤掉过期的回调
+        uint32_t gen = users_->Generation(fd);
+        timer_->add(fd, HttpConn::IdleTimeoutMs(), [this, client, fd, gen]() {
+            if(!users_->IsCurrent(fd, gen))
+                return;
+            // 正在工作线程中处理的连接不能在这里关闭，等它的完成记录到达后再关
+            if(workerState_[fd] != WORKER_IDLE)
+                workerState_[fd] = WORKER_BUSY_CLOSE;
+            else
+                CloseConn_(client);
+        });
     }
     epoller_->AddFd(fd, EPOLLIN | connEvent_);
     SetFdNonblock_(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
 void WebServer::DealListen_() {
@@ -165,49 +267,85 @@ void WebServer::DealListen_() {
         if(fd <= 0) {
             return ;
         }
-        else if(HttpConn::userCount >= MAX_FD) {
+        else if(HttpConn::userCount >= HttpConn::maxConn || !users_->Contains(fd)) {
             SendError_(fd, "Server busy!");
             LOG_WARN("Client is full!");
             return ;
         }
 
-        AddClient_(fd, addr);
+        if(subReactors_.empty()) {
+            AddClient_(fd, addr);
+        }
+        else {
+            SetFdNonblock_(fd);
+            NextSubReactor_()->AddConn(fd, addr);
+        }
     } while(listenEvent_ & EPOLLET);
 }
 
+// 从上次的位置开始轮询，选出连接数最少的从Reactor
+SubReactor* WebServer::NextSubReactor_() {
+    assert(!subReactors_.empty());
+    size_t n = subReactors_.size();
+    size_t best = nextReactor_ % n;
+    for(size_t i=1; i<n; i++) {
+        size_t j = (nextReactor_ + i) % n;
+        if(subReactors_[j]->ConnCount() < subReactors_[best]->ConnCount())
+            best = j;
+    }
+    nextReactor_ = best + 1;
+    return subReactors_[best].get();
+}
+
 void WebServer::DealRead_(HttpConn *client) {
     assert(client);
     ExtentTime_(client);
-    // threadPool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
-    threadPool_->AddTask([this, client]() { this->OnRead_(client); });
+    DispatchTask_(client, true);
 }
 
 void WebServer::DealWrite_(HttpConn *client) {
     assert(client);
     ExtentTime_(client);
-    threadPool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    DispatchTask_(client, false);
+}
+
+void WebServer::DispatchTask_(HttpConn *client, bool isRead) {
+    int fd = client->GetFd();
+    uint32_t gen = users_->Generation(fd);
+    workerState_[fd] = WORKER_BUSY;
+    // threadPool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
+    threadPool_->AddTask([this, client, fd, gen, isRead]() {
+        // 任务排队期间连接已被关闭或fd已被复用
+        if(!users_->IsCurrent(fd, gen)) return;
+        if(isRead)
+            this->OnRead_(client);
+        else
+            this->OnWrite_(client);
+    });
 }
 
 void WebServer::ExtentTime_(HttpConn *client) {
     assert(client);
     if(timeoutMs_ > 0)
-        timer_->adjust(client->GetFd(), timeoutMs_);
+        timer_->adjust(client->GetFd(), HttpConn::IdleTimeoutMs());
 }
 
 void WebServer::OnRead_(HttpConn *client) {
-    if(client->process()) {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-    }
-    else {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+    assert(client);
+    int readErrno = 0;
+    ssize_t ret = client->read(&readErrno);
+    if(ret <= 0 && readErrno != EAGAIN) {
+        Complete_(client, COMPLETE_CLOSE);
+        return;
     }
+    OnProcess_(client);
 } 
 
 void WebServer::OnProcess_(HttpConn* client) {
     if(client->process()) {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+        Complete_(client, COMPLETE_OUT);
     } else {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        Complete_(client, COMPLETE_IN);
     }
 }
 
@@ -224,25 +362,122 @@ void WebServer::OnWrite_(HttpConn* client) {
     }
     else if(ret < 0) {
         if(writeErrno == EAGAIN) {
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+            Complete_(client, COMPLETE_OUT);
             return ;
         }
     }
-    CloseConn_(client);
+    Complete_(client, COMPLETE_CLOSE);
+}
+
+// 工作线程调用：记录连接的去向，必要时唤醒Reactor
+void WebServer::Complete_(HttpConn* client, CompleteOp op) {
+    int fd = client->GetFd();
+    Completion item = { fd, users_->Generation(fd), op };
+    while(!completeQue_.push(item)) {
+        // 每个连接同一时刻最多一条记录，容量为MAX_FD时不会满
+        std::this_thread::yield();
+    }
+    if(!completeNotified_.exchange(true)) {
+        uint64_t one = 1;
+        if(::write(completeFd_, &one, sizeof(one)) != sizeof(one)) {
+            LOG_WARN("notify reactor error!");
+        }
+    }
+}
+
+// Reactor线程调用：一次取走所有完成记录，同一fd只保留最后一条（关闭优先），再统一epoll_ctl
+void WebServer::DealComplete_() {
+    uint64_t cnt;
+    ::read(completeFd_, &cnt, sizeof(cnt));
+    completeNotified_ = false;
+
+    batchNo_++;
+    completeBatch_.clear();
+    Completion item;
+    while(completeQue_.pop(item)) {
+        if(!users_->IsCurrent(item.fd, item.gen))
+            continue;
+        if(batchSeq_[item.fd] == batchNo_) {
+            Completion &prev = completeBatch_[batchIdx_[item.fd]];
+            if(prev.op != COMPLETE_CLOSE)
+                prev.op = item.op;
+            continue;
+        }
+        batchSeq_[item.fd] = batchNo_;
+        batchIdx_[item.fd] = completeBatch_.size();
+        completeBatch_.push_back(item);
+    }
+
+    for(const Completion &c : completeBatch_) {
+        HttpConn* client = users_->Get(c.fd);
+        bool closeLater = (workerState_[c.fd] == WORKER_BUSY_CLOSE);
+        workerState_[c.fd] = WORKER_IDLE;
+        if(c.op == COMPLETE_CLOSE || closeLater) {
+            CloseConn_(client);
+        }
+        else {
+            epoller_->ModFd(c.fd, connEvent_ | (c.op == COMPLETE_OUT ? EPOLLOUT : EPOLLIN));
+        }
+    }
 }
 
 bool WebServer::InitSocket_() {
-    int ret;
-    struct sockaddr_in addr;
-    
     if(port_ > 65535 || port_ < 1024) {         // 其中0到1023为特权端口或系统端口
-        LOG_ERROR("Port:5d error!", port_);
+        LOG_ERROR("Port:%d error!", port_);
         return false;
     }
 
+    // SO_REUSEPORT模式：每个从Reactor各自绑定一个监听socket，由内核在它们之间分发新连接
+    if(reusePort_) {
+        listenFd_ = -1;
+        for(auto &reactor : subReactors_) {
+            int fd = CreateListenFd_();
+            if(fd < 0)
+                return false;
+            reactor->SetListenFd(fd, listenEvent_);
+        }
+        for(auto &reactor : uringReactors_) {
+            int fd = CreateListenFd_();
+            if(fd < 0)
+                return false;
+            reactor->SetListenFd(fd, true);
+        }
+        LOG_INFO("Server port:%d, reuseport listeners:%d", port_,
+                    (int)(subReactors_.size() + uringReactors_.size()));
+        return true;
+    }
+
+    listenFd_ = CreateListenFd_();
+    if(listenFd_ < 0)
+        return false;
+
+    // 共享同一个监听socket，每个ring各自挂一个multishot accept
+    if(!uringReactors_.empty()) {
+        for(auto &reactor : uringReactors_) {
+            reactor->SetListenFd(listenFd_, false);
+        }
+        LOG_INFO("Server port:%d", port_);
+        return true;
+    }
+
+    int ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+    if(ret == 0) {
+        LOG_ERROR("Add listen error!");
+        close(listenFd_);
+        return false;
+    }
+
+    LOG_INFO("Server port:%d", port_);
+    return true;
+}
+
+// 创建、绑定并监听一个非阻塞socket，失败返回-1
+int WebServer::CreateListenFd_() {
+    int ret;
+    struct sockaddr_in addr;
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htonl(port_);
+    addr.sin_port = htons(port_);
     struct linger optLinger = {0};
     if(openLinger_) {
         // 直到所剩数据发送或超时关闭
@@ -250,50 +485,52 @@ bool WebServer::InitSocket_() {
         optLinger.l_linger = 1;
     }
 
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if(listenFd_ < 0) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) {
         LOG_ERROR("Create socket error!", port_);
-        return false;
+        return -1;
     }
 
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(fd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if(ret < 0) {
         LOG_ERROR("Init linger error!");
-        close(listenFd_);
-        return false;
+        close(fd);
+        return -1;
     }
 
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &optLinger, sizeof(optLinger));
+    int optval = 1;
+    ret = setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
     if(ret == -1) {
         LOG_ERROR("set socket setsockopt error!");
-        close(listenFd_);
-        return false;
+        close(fd);
+        return -1;
+    }
+
+    if(reusePort_) {
+        ret = setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+        if(ret == -1) {
+            LOG_ERROR("set socket SO_REUSEPORT error!");
+            close(fd);
+            return -1;
+        }
     }
 
-    ret = bind(listenFd_, (struct sockaddr*)&addr, sizeof(addr));
+    ret = bind(fd, (struct sockaddr*)&addr, sizeof(addr));
     if(ret < 0) {
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
-        return false;
+        close(fd);
+        return -1;
     }
 
-    ret = listen(listenFd_, 6);
+    ret = listen(fd, backlog_);
     if(ret < 0) {
         LOG_ERROR("listen Port:%d error!", port_);
-        close(listenFd_);
-        return false;
-    }
-
-    ret = epoller_->AddFd(listenFd_, listenFd_ | EPOLLIN);
-    if(ret == 0) {
-        LOG_ERROR("Add listen error!");
-        close(listenFd_);
-        return false;
+        close(fd);
+        return -1;
     }
 
-    SetFdNonblock_(listenFd_);
-    LOG_INFO("Server port:%d", port_);
-    return true;
+    SetFdNonblock_(fd);
+    return fd;
 }
 
 int WebServer::SetFdNonblock_(int fd) {
@@ -1,7 +1,8 @@
 #pragma once
 
-#include <unordered_map>
 #include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <assert.h>
 #include <errno.h>
@@ -10,11 +11,16 @@
 #include <arpa/inet.h>
 
 #include "epoller.h"
+#include "conntable.h"
+#include "mpscqueue.h"
+#include "subreactor.h"
+#include "uringreactor.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/treadpool.h"
 #include "../pool/sqlconnRAII.h"
 #include "../http/httpconn.h"
+#include "../http/filecache.h"
 #include "../timer/heaptimer.h"
 
 class WebServer{
@@ -23,17 +29,21 @@ public:
         int port, int trigMode, int timeoutMs, bool OptLinger,
         int sqlPort, const char* sqlUser, const char* sqlPwd,
         const char* dbName, int connPoolNum, int thhreadNum,
-        bool openLog, int logLevel, int logQueSize);
+        bool openLog, int logLevel, int logQueSize,
+        int subReactorNum = 0, bool reusePort = false, int backlog = SOMAXCONN,
+        bool ioUring = false);
     
     ~WebServer();
     void Start();
 private:
     
     bool InitSocket_();
+    int CreateListenFd_();
     void InitEventMode_(int trigMode);
     void AddClient_(int fd, sockaddr_in addr);
 
     void DealListen_();
+    SubReactor* NextSubReactor_();
     void DealRead_(HttpConn* client);
     void DealWrite_(HttpConn* client);
 
@@ -47,6 +57,29 @@ private:
 
     void OnWrite_(HttpConn* client);
 
+    // 工作线程处理完一个连接后的去向，由Reactor线程统一执行
+    enum CompleteOp : uint8_t {
+        COMPLETE_IN = 0,        // 重新监听读事件
+        COMPLETE_OUT,           // 重新监听写事件
+        COMPLETE_CLOSE,         // 关闭连接
+    };
+    struct Completion {
+        int fd;
+        uint32_t gen;
+        uint8_t op;
+    };
+
+    // 连接在工作线程中的状态，只在Reactor线程中读写
+    enum WorkerState : uint8_t {
+        WORKER_IDLE = 0,
+        WORKER_BUSY,            // 已交给线程池，尚未完成
+        WORKER_BUSY_CLOSE,      // 处理期间超时，完成后直接关闭
+    };
+
+    void Complete_(HttpConn* client, CompleteOp op);
+    void DealComplete_();
+    void DispatchTask_(HttpConn* client, bool isRead);
+
     static const int MAX_FD = 65536;
 
     static int SetFdNonblock_(int fd);
@@ -55,6 +88,8 @@ private:
     bool openLinger_;
     int timeoutMs_;
     bool isClose_;
+    bool reusePort_;
+    int backlog_;
     int listenFd_;
     char* srcDir_;
 
@@ -64,6 +99,19 @@ private:
     std::unique_ptr<HeapTimer> timer_;
     std::unique_ptr<ThreadPool> threadPool_;
     std::unique_ptr<Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
+    std::unique_ptr<ConnTable<HttpConn>> users_;          // 单Reactor模式的连接表，主从模式下各从Reactor各有一份
+
+    int completeFd_;                                      // eventfd，工作线程通知Reactor有完成记录
+    std::atomic<bool> completeNotified_;                  // 已写过eventfd尚未被Reactor取走，避免重复写
+    MpscQueue<Completion> completeQue_;
+    std::vector<Completion> completeBatch_;
+    std::unique_ptr<uint32_t[]> batchSeq_;                // fd在第几批中出现过，用于合并同一fd的多条记录
+    std::unique_ptr<uint32_t[]> batchIdx_;
+    uint32_t batchNo_;
+    std::unique_ptr<uint8_t[]> workerState_;
+
+    std::vector<std::unique_ptr<SubReactor>> subReactors_;  // 为空时为单Reactor + 线程池模式
+    size_t nextReactor_;
+    std::vector<std::unique_ptr<UringReactor>> uringReactors_;  // 非空时使用io_uring后端
 };
 
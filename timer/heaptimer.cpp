@@ -2,12 +2,12 @@
 
 void HeapTimer::siftup_(size_t i) {
     assert(i>=0 && i<heap_.size());
-    size_t j = (i-1)/2;
-    while(j>=0) {
+    // size_t没有负数，i为0时(i-1)/2会回绕，必须先判断是否已到堆顶
+    while(i > 0) {
+        size_t j = (i-1)/2;
         if(heap_[j] < heap_[i]) break;
         SwapNode_(i, j);
         i = j;
-        j = (i-1)/2;
     }
 }
 
@@ -82,8 +82,11 @@ void HeapTimer::del_(size_t index) {
 
 void HeapTimer::adjust(int id, int timeout) {
     assert(!heap_.empty() && ref_.count(id)>0);
-    heap_[ref_[id]].expires = Clock::now() + MS(timeout);
-    siftdown_(ref_[id], heap_.size());
+    size_t i = ref_[id];
+    heap_[i].expires = Clock::now() + MS(timeout);
+    // 超时时间会随负载缩短，新的到期时间可能早于原来的，两个方向都要调整
+    if(!siftdown_(i, heap_.size()))
+        siftup_(i);
 }
 
 // 清除超时节点
@@ -16,5 +16,12 @@ int main()
     std::this_thread::sleep_for(std::chrono::seconds(4));
     timer.tick();
 
+    // 缩短超时后应排到堆顶先触发
+    timer.add(2, 5000, []() { std::cout << "Timer 2 exprired\n"; });
+    timer.add(3, 6000, []() { std::cout << "Timer 3 exprired\n"; });
+    timer.adjust(3, 500);
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    timer.tick();
+
     return 0;
 }
\ No newline at end of file